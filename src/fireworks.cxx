@@ -9,6 +9,11 @@
 //
 // Needs to be compiled manually ('make fireworks' or use fltk-config).
 //
+// Options:
+//   f               fullscreen
+//   s               scale up (can be repeated)
+//   --bench [secs]  measure particle update and draw rate (default 5s each)
+//
 #include <iostream>
 //#define DBG(a) std::cout << a << std::endl
 #define DBG(a)
@@ -72,22 +77,126 @@ private:
 
 #include <FL/Fl_Double_Window.H>
 #include <FL/Fl.H>
+#ifndef WIN32
+#include <sys/time.h>
+#else
+#include <windows.h>
+#endif
+#include <cstdio>
+
+static double now()
+{
+#ifndef WIN32
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1000000.;
+#else
+	return GetTickCount() / 1000.;
+#endif
+}
 
 //-------------------------------------------------------------------------------
-int main( int argc_, const char *argv_[] )
+class BenchWindow : public Fl_Double_Window
 //-------------------------------------------------------------------------------
 {
-	Fl_Double_Window win( 800, 600, "Fireworks demo" );
-	win.resizable(win);
+typedef Fl_Double_Window Inherited;
+public:
+	BenchWindow( int w_, int h_, Fl_Firework_Engine& engine_ ) :
+		Inherited( w_, h_, "Fireworks benchmark" ),
+		_engine( engine_ )
+	{
+		color( FL_BLACK );
+		end();
+	}
+	void draw()
+	{
+		Inherited::draw();
+		_engine.draw();
+	}
+private:
+	Fl_Firework_Engine& _engine;
+};
+
+static void report( const char *what_, uint64_t particles_,
+                    unsigned long ticks_, double secs_ )
+{
+	printf( "%-10s %8lu ticks %8.2f s  %7.0f particles/tick  %12.0f particles/s\n",
+	        what_, ticks_, secs_, ticks_ ? (double)particles_ / ticks_ : 0.,
+	        secs_ > 0 ? particles_ / secs_ : 0. );
+}
+
+// Run simulation without display, then update and draw as fast as
+// possible into a window, both for 'secs_' seconds (fixed seed).
+static int bench( double secs_, bool fullscreen_ )
+{
+	{
+		Fl_Firework_Engine engine( 1920, 1080, 8, 1 );
+		engine.scale( Scale, Scale );
+		unsigned long ticks = 0;
+		double start = now();
+		double t = start;
+		while ( t - start < secs_ )
+		{
+			for ( int i = 0; i < 100; i++ )
+				engine.update();
+			ticks += 100;
+			t = now();
+		}
+		report( "update", engine.updated(), ticks, t - start );
+	}
+
+	Fl_Firework_Engine engine( 800, 600, 8, 1 );
+	engine.scale( Scale, Scale );
+	BenchWindow win( 800, 600, engine );
 	win.show();
+	if ( fullscreen_ )
+		win.fullscreen();
+	Fl::check();
+	engine.size( win.w(), win.h() );
+	unsigned long ticks = 0;
+	double start = now();
+	double t = start;
+	while ( win.shown() && t - start < secs_ )
+	{
+		engine.update();
+		win.redraw();
+		Fl::check();
+		ticks++;
+		t = now();
+	}
+	report( "draw", engine.drawn(), ticks, t - start );
+	return 0;
+}
+
+//-------------------------------------------------------------------------------
+int main( int argc_, const char *argv_[] )
+//-------------------------------------------------------------------------------
+{
+	bool fullscreen = false;
+	double benchSecs = 0;
 	for ( int i = 1; i < argc_; i++ )
 	{
 		std::string arg( argv_[i] );
+		if ( arg == "--bench" )
+		{
+			benchSecs = 5.;
+			if ( i + 1 < argc_ && atof( argv_[i + 1] ) > 0 )
+				benchSecs = atof( argv_[++i] );
+			continue;
+		}
 		if ( arg.find( 'f' ) != std::string::npos )
-			win.fullscreen();
+			fullscreen = true;
 		if ( arg.find( 's' ) != std::string::npos )
 			Scale++;
 	}
+	if ( benchSecs )
+		return bench( benchSecs, fullscreen );
+
+	Fl_Double_Window win( 800, 600, "Fireworks demo" );
+	win.resizable(win);
+	win.show();
+	if ( fullscreen )
+		win.fullscreen();
 	Fireworks fireworks( win  );
 	while (win.shown() && win.children())
 		Fl::wait();
@@ -0,0 +1,597 @@
+//
+// Copyright 2015-2025 Christian Grabner.
+//
+// This file is part of FLTrator.
+//
+// FLTrator is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FLTrator is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY;  without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details:
+// http://www.gnu.org/licenses/.
+//
+//  Microbenchmarks of the game's hot code paths ('make bench').
+//
+//  The game is compiled in (without its main()), so the kernels run
+//  the real code with fixed inputs: the levels and demos of the
+//  resource directory and synthetic images. Results are written as
+//  JSON to stdout (see bench.H), progress to stderr.
+//
+//  The game window is opened (sound off), as terrain collision reads
+//  back the screen, so a display is needed (or e.g. xvfb-run).
+//
+//  With the builtin image resampler (FLTK < 1.4) its packed RGBA path
+//  is first checked against the per channel path for the game images
+//  (sprites and the decorations of the level directories)
+//  and the synthetic image, and fl_copy_image() against
+//  Fl_RGB_Image::copy() (only without the resampler built in, as they
+//  differ then). Any difference fails the run (exit code 1).
+//  The same is done for the SIMD and scalar paths of the pixel kernels,
+//  which are also measured on a level sized image (as in the prebuild
+//  of the landscape).
+//
+#define FLTRATOR_BENCH
+#define ALLOC_TRACK	// count heap bytes per operation
+#include "fltrator.cxx"
+#include "bench.H"
+
+//-------------------------------------------------------------------------------
+class FLTratorBench
+//-------------------------------------------------------------------------------
+{
+public:
+	FLTratorBench( FLTrator& f_ );
+	~FLTratorBench();
+	void run( Bench& bench_ );
+	bool verifyResample() const;
+	bool verifyCopy() const;
+	bool verifyPixels() const;
+private:
+	static void collisionWithObject( void *d_ );
+	static void collisionWithTerrain( void *d_ );
+	static void explosion( void *d_ );
+	static void loadLevel( void *d_ );
+	static void loadDemoData( void *d_ );
+	static void resizeImage( void *d_ );
+	static void copyInput( void *d_ );
+	static void colorToTransparence( void *d_ );
+	static void faintoutRgbImage( void *d_ );
+	static void imageGetSame( void *d_ );
+	static void imageGetOther( void *d_ );
+	static void colorKeyLevel( void *d_ );
+	static void blendLevel( void *d_ );
+#if !(FLTK_HAS_IMAGE_SCALING)
+	static void resampleUp( void *d_ );
+	static void resampleDown( void *d_ );
+	static void resampleLarge( void *d_ );
+	static int compareResample( const uchar *data_, int w_, int h_, int w2_, int h2_ );
+	void testImages( vector<const Fl_RGB_Image *>& images_, vector<string>& names_ ) const;
+	static void addTestImages( const string& dir_, const string& prefix_,
+	                           vector<const Fl_RGB_Image *>& images_, vector<string>& names_ );
+#endif
+	static void result( const Bench::Result& r_ );
+private:
+	FLTrator& _f;
+	Rocket *_rocket;
+	Radar *_radar;
+	Fl_RGB_Image *_rgb;
+	Fl_RGB_Image *_work;	// fresh copy of _rgb for in-place kernels
+	FltImage _image;
+	string _image1;
+	string _image2;
+	bool _other;
+	uchar *_target;	// resampler output (800x600 RGBA)
+	const Fl_RGB_Image *_large;	// largest game image
+	bool _packed;
+	vector<uchar> _levelImage;	// level sized RGBA image
+	bool _simd;
+};
+
+FLTratorBench::FLTratorBench( FLTrator& f_ ) :
+	_f( f_ ),
+	_rocket( 0 ),
+	_radar( 0 ),
+	_rgb( 0 ),
+	_work( 0 ),
+	_image1( imgPath.get( "rocket.gif" ) ),
+	_image2( imgPath.get( "radar.gif" ) ),
+	_other( false ),
+	_target( new uchar[ 800 * 600 * 4 ] ),
+	_large( 0 ),
+	_packed( true ),
+	_simd( true )
+//-------------------------------------------------------------------------------
+{
+	// overlapping by half
+	_rocket = new Rocket( 400, 300 );
+	_radar = new Radar( 400 + _rocket->w() / 2, 300 + _rocket->h() / 2 );
+
+	// synthetic 512x512 RGBA image (gradient with some bluebox pixels)
+	static const int W = 512;
+	static const int H = 512;
+	uchar r, g, b;
+	Fl::get_color( BlueBoxColor, r, g, b );
+	uchar *data = new uchar[ W * H * 4 ];
+	for ( int y = 0; y < H; y++ )
+	{
+		for ( int x = 0; x < W; x++ )
+		{
+			uchar *p = data + ( y * W + x ) * 4;
+			bool bluebox = ( ( x / 16 ) + ( y / 16 ) ) % 3 == 0;
+			p[0] = bluebox ? r : x / 2;
+			p[1] = bluebox ? g : y / 2;
+			p[2] = bluebox ? b : ( x + y ) / 4;
+			p[3] = 0xff;
+		}
+	}
+	_rgb = new Fl_RGB_Image( data, W, H, 4 );
+	_rgb->alloc_array = 1;
+	_work = new Fl_RGB_Image( new uchar[ W * H * 4 ], W, H, 4 );
+	_work->alloc_array = 1;
+}
+
+FLTratorBench::~FLTratorBench()
+//-------------------------------------------------------------------------------
+{
+	delete _rocket;
+	delete _radar;
+	delete _rgb;
+	delete _work;
+	delete[] _target;
+}
+
+/*static*/
+void FLTratorBench::collisionWithObject( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	b->_rocket->collisionWithObject( *b->_radar );
+}
+
+/*static*/
+void FLTratorBench::collisionWithTerrain( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	b->_f.collisionWithTerrain( *b->_f._spaceship );
+}
+
+/*static*/
+void FLTratorBench::explosion( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	// whole life of a big explosion
+	static const Fl_Color colors[] = { FL_WHITE, FL_CYAN };
+	Explosion e( 400, 300, Explosion::MC_FALLOUT_STRIKE, 2.0, colors, nbrOfItems( colors ) );
+	while ( !e.done() )
+		e.update();
+}
+
+/*static*/
+void FLTratorBench::loadLevel( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	for ( unsigned level = 1; level <= MAX_LEVEL; level++ )
+	{
+		string name;
+		b->_f.T.clear();
+		b->_f._ini.clear();
+		b->_f.loadLevel( level, name );
+	}
+}
+
+/*static*/
+void FLTratorBench::loadDemoData( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	for ( unsigned level = 1; level <= MAX_LEVEL; level++ )
+		b->_f.loadDemoData( level );
+}
+
+/*static*/
+void FLTratorBench::resizeImage( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	delete fl_copy_image( b->_rgb, 800, 600 );
+}
+
+/*static*/
+void FLTratorBench::copyInput( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	// color_to_transparence() and faintout_rgb_image() change the image,
+	// so each call gets a fresh copy (this is the cost of copying)
+	FLTratorBench *b = (FLTratorBench *)d_;
+	memcpy( (uchar *)b->_work->data()[0], b->_rgb->data()[0],
+	        b->_rgb->w() * b->_rgb->h() * b->_rgb->d() );
+	b->_work->uncache();
+}
+
+/*static*/
+void FLTratorBench::colorToTransparence( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	copyInput( d_ );
+	color_to_transparence( b->_work, BlueBoxColor );
+}
+
+/*static*/
+void FLTratorBench::faintoutRgbImage( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	copyInput( d_ );
+	faintout_rgb_image( b->_work );
+}
+
+/*static*/
+void FLTratorBench::imageGetSame( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	b->_image.get( b->_image1.c_str() );
+}
+
+/*static*/
+void FLTratorBench::imageGetOther( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	b->_other = !b->_other;
+	b->_image.get( b->_other ? b->_image2.c_str() : b->_image1.c_str() );
+}
+
+/*static*/
+void FLTratorBench::colorKeyLevel( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	Pixels::colorKey( &b->_levelImage[0], b->_levelImage.size() / 4, 254, 254, 254, 0, b->_simd );
+}
+
+/*static*/
+void FLTratorBench::blendLevel( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	Pixels::blend( &b->_levelImage[0], b->_levelImage.size() / 4, 4, 192, 192, 192, 0.3, b->_simd );
+}
+
+#if !(FLTK_HAS_IMAGE_SCALING)
+/*static*/
+void FLTratorBench::resampleUp( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	resample( 800, 600, (const uchar *)b->_rgb->data()[0], b->_rgb->w(), b->_rgb->h(), 4,
+	          0, 0, b->_target, 0, 0, true, b->_packed );
+}
+
+/*static*/
+void FLTratorBench::resampleDown( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	resample( 200, 150, (const uchar *)b->_rgb->data()[0], b->_rgb->w(), b->_rgb->h(), 4,
+	          0, 0, b->_target, 0, 0, true, b->_packed );
+}
+
+/*static*/
+void FLTratorBench::resampleLarge( void *d_ )
+//-------------------------------------------------------------------------------
+{
+	FLTratorBench *b = (FLTratorBench *)d_;
+	resample( 800, 600, (const uchar *)b->_large->data()[0], b->_large->w(), b->_large->h(), 4,
+	          0, 0, b->_target, 0, 0, true, b->_packed );
+}
+
+/*static*/
+int FLTratorBench::compareResample( const uchar *data_, int w_, int h_, int w2_, int h2_ )
+//-------------------------------------------------------------------------------
+{
+	// packed vs. per channel resampling, with and without alpha premultiplication
+	int errors = 0;
+	for ( int premultiply = 0; premultiply < 2; premultiply++ )
+	{
+		uchar *packed = resample( w2_, h2_, data_, w_, h_, 4, 0, 0, 0, 0, 0, premultiply, true );
+		uchar *channels = resample( w2_, h2_, data_, w_, h_, 4, 0, 0, 0, 0, 0, premultiply, false );
+		if ( memcmp( packed, channels, w2_ * h2_ * 4 ) )
+			errors++;
+		delete[] packed;
+		delete[] channels;
+	}
+	return errors;
+}
+
+void FLTratorBench::testImages( vector<const Fl_RGB_Image *>& images_,
+                                vector<string>& names_ ) const
+//-------------------------------------------------------------------------------
+{
+	// the synthetic image and the RGBA game images (first one not owned)
+	images_.push_back( _rgb );
+	names_.push_back( "synthetic" );
+	addTestImages( mkPath( "images" ), "", images_, names_ );
+}
+
+/*static*/
+void FLTratorBench::addTestImages( const string& dir_, const string& prefix_,
+                                   vector<const Fl_RGB_Image *>& images_,
+                                   vector<string>& names_ )
+//-------------------------------------------------------------------------------
+{
+	// sprites (*.gif) and decorations (*.png) of 'dir_' and
+	// (from the top directory) of the level directories
+#if FLTK_HAS_NEW_FUNCTIONS
+	dirent **ls;
+	int num_files = fl_filename_list( dir_.c_str(), &ls, fl_casealphasort );
+	for ( int i = 0; i < num_files; i++ )
+	{
+		string name( ls[i]->d_name );
+		if ( name.size() && name[ name.size() - 1 ] == '/' )
+			name.erase( name.size() - 1 );
+		string path( dir_ + name );
+		if ( prefix_.empty() && atoi( name.c_str() ) > 0 &&
+		     fl_filename_isdir( path.c_str() ) )
+		{
+			addTestImages( path + "/", name + "/", images_, names_ );
+			continue;
+		}
+		Fl_RGB_Image *rgb = 0;
+		if ( fl_filename_match( name.c_str(), "*.gif" ) )
+		{
+			Fl_Image *image = decodeImage( path );
+			if ( image && image->count() > 2 )
+				rgb = new Fl_RGB_Image( (Fl_Pixmap *)image );
+			delete image;
+		}
+		else if ( fl_filename_match( name.c_str(), "*.png" ) )
+		{
+			rgb = new Fl_PNG_Image( path.c_str() );
+			if ( rgb->fail() )
+			{
+				delete rgb;
+				rgb = 0;
+			}
+		}
+		if ( rgb && rgb->d() == 4 )
+		{
+			images_.push_back( rgb );
+			names_.push_back( prefix_ + name );
+		}
+		else
+			delete rgb;
+	}
+	fl_filename_free_list( &ls, num_files );
+#endif
+}
+#endif
+
+bool FLTratorBench::verifyResample() const
+//-------------------------------------------------------------------------------
+{
+#if !(FLTK_HAS_IMAGE_SCALING)
+	vector<const Fl_RGB_Image *> images;
+	vector<string> names;
+	testImages( images, names );
+	int errors = 0;
+	for ( size_t i = 0; i < images.size(); i++ )
+	{
+		const Fl_RGB_Image *image = images[i];
+		int w = image->w();
+		int h = image->h();
+		if ( w < 2 || h < 2 )	// (resampler does not upscale single pixel rows)
+			continue;
+		// down, up and asymmetric sizes
+		const int sizes[][2] = { { w / 2 + 1, h / 2 + 1 }, { w * 3 / 2 + 1, h * 2 },
+		                         { w * 2, h / 3 + 1 }, { w / 3 + 1, h * 3 + 1 },
+		                         { 800, 600 } };
+		int e = 0;
+		for ( size_t j = 0; j < nbrOfItems( sizes ); j++ )
+			e += compareResample( (const uchar *)image->data()[0], w, h, sizes[j][0], sizes[j][1] );
+		if ( e )
+			cerr << "resample: packed RGBA differs from per channel result for " << names[i] << endl;
+		errors += e;
+	}
+	for ( size_t i = 1; i < images.size(); i++ )
+		delete images[i];
+	cerr << "resample: " << images.size() << " images verified, "
+	     << ( errors ? "FAILED" : "ok" ) << endl;
+	return !errors;
+#else
+	return true;
+#endif
+}
+
+bool FLTratorBench::verifyCopy() const
+//-------------------------------------------------------------------------------
+{
+	// fl_copy_image() must scale like Fl_RGB_Image::copy(), which it
+	// replaces for the game (not compared with the builtin resampler
+	// enabled, as its results are different by design)
+#if !(FLTK_HAS_IMAGE_SCALING) && defined(KANTOR_RESAMPLE)
+	cerr << "fl_copy_image: builtin resampler, not compared to Fl_RGB_Image::copy()" << endl;
+	return true;
+#elif !(FLTK_HAS_IMAGE_SCALING)
+	vector<const Fl_RGB_Image *> images;
+	vector<string> names;
+	testImages( images, names );
+#if FLTK_HAS_NEW_FUNCTIONS
+	Fl_RGB_Scaling scaling = Fl_Image::RGB_scaling();
+	Fl_Image::RGB_scaling( FL_RGB_SCALING_BILINEAR );	// as set by the game
+#endif
+	int errors = 0;
+	for ( size_t i = 0; i < images.size(); i++ )
+	{
+		Fl_RGB_Image *image = (Fl_RGB_Image *)images[i];
+		const int sizes[][2] = { { image->w() / 2 + 1, image->h() / 2 + 1 },
+		                         { image->w() * 3 / 2 + 1, image->h() * 2 }, { 800, 600 } };
+		for ( size_t j = 0; j < nbrOfItems( sizes ); j++ )
+		{
+			Fl_Image *a = fl_copy_image( image, sizes[j][0], sizes[j][1] );
+			Fl_Image *b = image->copy( sizes[j][0], sizes[j][1] );
+			size_t n = (size_t)b->w() * b->h() * b->d();
+			if ( a->w() != b->w() || a->h() != b->h() || a->d() != b->d() ||
+			     memcmp( a->data()[0], b->data()[0], n ) )
+			{
+				cerr << "fl_copy_image: differs from Fl_RGB_Image::copy() for " << names[i]
+				     << " " << sizes[j][0] << "x" << sizes[j][1] << endl;
+				errors++;
+			}
+			delete a;
+			delete b;
+		}
+	}
+#if FLTK_HAS_NEW_FUNCTIONS
+	Fl_Image::RGB_scaling( scaling );
+#endif
+	for ( size_t i = 1; i < images.size(); i++ )
+		delete images[i];
+	cerr << "fl_copy_image: " << images.size() << " images verified, "
+	     << ( errors ? "FAILED" : "ok" ) << endl;
+	return !errors;
+#else
+	return true;
+#endif
+}
+
+bool FLTratorBench::verifyPixels() const
+//-------------------------------------------------------------------------------
+{
+	// SIMD vs. scalar path on the synthetic image (with bluebox pixels)
+	const uchar *data = (const uchar *)_rgb->data()[0];
+	size_t n = _rgb->w() * _rgb->h();
+	uchar r, g, b;
+	Fl::get_color( BlueBoxColor, r, g, b );
+	int errors = 0;
+	for ( int kernel = 0; kernel < 2; kernel++ )
+	{
+		vector<uchar> simd( data, data + n * 4 );
+		vector<uchar> scalar( simd );
+		for ( int i = 0; i < 2; i++ )
+		{
+			vector<uchar>& p = i ? scalar : simd;
+			// (odd size for the scalar rest)
+			if ( kernel == 0 )
+				Pixels::colorKey( &p[0], n - 3, r, g, b, 0, !i );
+			else
+				Pixels::blend( &p[0], n - 3, 4, 192, 192, 192, 0.3, !i );
+		}
+		if ( simd != scalar )
+			errors++;
+	}
+	cerr << "pixels: " << ( errors ? "FAILED" : "ok" ) << endl;
+	return !errors;
+}
+
+/*static*/
+void FLTratorBench::result( const Bench::Result& r_ )
+//-------------------------------------------------------------------------------
+{
+	cerr << left << setw( 32 ) << r_.name << right << fixed << setprecision( 1 )
+	     << setw( 14 ) << r_.ns << " ns/op"
+	     << setw( 12 ) << r_.bytes << " bytes/op" << endl;
+}
+
+void FLTratorBench::run( Bench& bench_ )
+//-------------------------------------------------------------------------------
+{
+	result( bench_.measure( "collisionWithObject", collisionWithObject, this ) );
+
+	// terrain collision: ship on empty background (whole area is compared)
+	string name;
+	_f.T.clear();
+	_f.loadLevel( 1, name );
+	_f.make_current();
+	fl_rectf( 0, 0, _f.logicalW(), _f.logicalH(), _f.T.bg_color );
+	result( bench_.measure( "collisionWithTerrain", collisionWithTerrain, this ) );
+
+	result( bench_.measure( "Explosion::update", explosion, this ) );
+	result( bench_.measure( "loadLevel", loadLevel, this, MAX_LEVEL ) );
+	result( bench_.measure( "loadDemoData", loadDemoData, this, MAX_LEVEL ) );
+	result( bench_.measure( "fl_copy_image 512x512->800x600", resizeImage, this ) );
+#if !(FLTK_HAS_IMAGE_SCALING)
+	_packed = false;
+	result( bench_.measure( "resample 512x512->800x600 (channels)", resampleUp, this ) );
+	result( bench_.measure( "resample 512x512->200x150 (channels)", resampleDown, this ) );
+	_packed = true;
+	result( bench_.measure( "resample 512x512->800x600 (packed)", resampleUp, this ) );
+	result( bench_.measure( "resample 512x512->200x150 (packed)", resampleDown, this ) );
+
+	// largest game image (a level decoration) up to window size
+	vector<const Fl_RGB_Image *> images;
+	vector<string> names;
+	testImages( images, names );
+	size_t large = 0;
+	for ( size_t i = 1; i < images.size(); i++ )
+		if ( !large || images[i]->w() * images[i]->h() > images[large]->w() * images[large]->h() )
+			large = i;
+	if ( large )
+	{
+		_large = images[large];
+		result( bench_.measure( "resample " + names[large] + "->800x600 (packed)", resampleLarge, this ) );
+		_large = 0;
+	}
+	for ( size_t i = 1; i < images.size(); i++ )
+		delete images[i];
+#endif
+	result( bench_.measure( "copy 512x512 (included below)", copyInput, this ) );
+	result( bench_.measure( "color_to_transparence 512x512", colorToTransparence, this ) );
+	result( bench_.measure( "faintout_rgb_image 512x512", faintoutRgbImage, this ) );
+
+	// pixel kernels on an image of the size of the prebuilt landscape of level 1
+	_f.T.clear();
+	_f.loadLevel( 1, name );
+	const uchar *data = (const uchar *)_rgb->data()[0];
+	size_t size = _rgb->w() * _rgb->h() * 4;
+	_levelImage.resize( (size_t)_f.T.size() * _f.logicalH() * 4 );
+	for ( size_t i = 0; i < _levelImage.size(); i += size )
+		copy( data, data + min( size, _levelImage.size() - i ), _levelImage.begin() + i );
+	for ( int simd = 0; simd < 2; simd++ )
+	{
+		_simd = simd;
+		string type( simd ? " (simd)" : " (scalar)" );
+		result( bench_.measure( "Pixels::colorKey level" + type, colorKeyLevel, this ) );
+		result( bench_.measure( "Pixels::blend level" + type, blendLevel, this ) );
+	}
+	result( bench_.measure( "FltImage::get (same)", imageGetSame, this ) );
+	result( bench_.measure( "FltImage::get (other)", imageGetOther, this ) );
+}
+
+int main( int argc_, const char *argv_[] )
+//-------------------------------------------------------------------------------
+{
+	atexit( cleanup );
+	fl_register_images();
+	setupImageCache();
+	startupTasks();
+
+	// run quiet, without demo and pausing (further options are passed on)
+	vector<const char *> args;
+	args.push_back( argv_[0] );
+	args.push_back( "-sbdpo" );
+	for ( int i = 1; i < argc_; i++ )
+		args.push_back( argv_[i] );
+	args.push_back( 0 );
+	FLTrator fltrator( args.size() - 1, &args[0] );
+	for ( int i = 0; i < 10; i++ )	// let window be mapped
+		Fl::wait( 0.05 );
+
+	Bench bench;
+	{
+		FLTratorBench fltratorBench( fltrator );
+		if ( !fltratorBench.verifyResample() || !fltratorBench.verifyCopy() ||
+		     !fltratorBench.verifyPixels() )
+			return 1;
+		fltratorBench.run( bench );
+	}
+	bench.report( cout, VERSION );
+	return 0;
+}
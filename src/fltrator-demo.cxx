@@ -0,0 +1,135 @@
+//
+// Copyright 2015-2016 Christian Grabner.
+//
+// This file is part of FLTrator.
+//
+// FLTrator is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation,  either version 3 of the License, or
+// (at your option) any later version.
+//
+// FLTrator is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY;  without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details:
+// http://www.gnu.org/licenses/.
+//
+//  Converts demo files (see demo_file.H) between text format ('.txt')
+//  and binary format ('.dmo'). The output file has the same name with
+//  the other extension. Converted binary demos are verified by decoding
+//  them again.
+//
+#include "demo_file.H"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fstream>
+
+using namespace std;
+
+static bool hasExt( const string& name_, const char *ext_ )
+{
+	size_t len = strlen( ext_ );
+	return name_.size() > len && name_.compare( name_.size() - len, len, ext_ ) == 0;
+}
+
+static bool toBinary( const string& in_, const string& out_ )
+{
+	ifstream f( in_.c_str() );
+	DemoFile::Header h;
+	vector<DemoFile::Item> items;
+	if ( !f.is_open() || !DemoFile::readText( f, h, &items ) )
+	{
+		fprintf( stderr, "can't read '%s'\n", in_.c_str() );
+		return false;
+	}
+	vector<unsigned char> data;
+	DemoFile::encode( h, items, data );
+	size_t size = data.size();
+
+	ofstream o( out_.c_str(), ios::out | ios::binary );
+	if ( !o.write( (const char *)&data[0], size ) || ( o.close(), o.fail() ) )
+	{
+		fprintf( stderr, "can't write '%s'\n", out_.c_str() );
+		return false;
+	}
+
+	DemoFile::Reader r;
+	bool ok = r.open( data ) && r.size() == items.size();
+	DemoFile::Item item;
+	for ( size_t i = 0; ok && i < items.size(); i++ )
+		ok = r.get( i, item ) && item == items[i];
+	for ( size_t i = items.size(); ok && i-- > 0; )	// random access backwards
+		ok = r.get( i, item ) && item == items[i];
+	if ( !ok )
+	{
+		fprintf( stderr, "verifying '%s' failed\n", out_.c_str() );
+		return false;
+	}
+	f.clear();
+	printf( "%s: %lu items, %ld -> %lu bytes\n", out_.c_str(),
+	        (unsigned long)items.size(), (long)f.seekg( 0, ios::end ).tellg(),
+	        (unsigned long)size );
+	return true;
+}
+
+static bool toText( const string& in_, const string& out_ )
+{
+	ifstream f( in_.c_str(), ios::in | ios::binary );
+	vector<unsigned char> data;
+	DemoFile::read( f, data );
+	DemoFile::Reader r;
+	if ( !f.is_open() || !r.open( data ) )
+	{
+		fprintf( stderr, "can't read '%s'\n", in_.c_str() );
+		return false;
+	}
+	vector<DemoFile::Item> items( r.size() );
+	for ( size_t i = 0; i < items.size(); i++ )
+		if ( !r.get( i, items[i] ) )
+		{
+			fprintf( stderr, "'%s' is corrupt\n", in_.c_str() );
+			return false;
+		}
+	ofstream o( out_.c_str() );
+	DemoFile::writeText( o, r.header(), items );
+	o.close();
+	if ( o.fail() )
+	{
+		fprintf( stderr, "can't write '%s'\n", out_.c_str() );
+		return false;
+	}
+	printf( "%s: %lu items\n", out_.c_str(), (unsigned long)items.size() );
+	return true;
+}
+
+int main( int argc_, const char *argv_[] )
+{
+	if ( argc_ < 2 || argv_[1][0] == '-' )
+	{
+		printf( "Usage:\n  %s demofile...\n\n"
+		        "Converts text demos (.txt) to binary (.dmo) and vice versa.\n", argv_[0] );
+		return argc_ < 2 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+	int ret = EXIT_SUCCESS;
+	for ( int i = 1; i < argc_; i++ )
+	{
+		string in( argv_[i] );
+		string base( in, 0, in.size() - 4 );
+		bool ok;
+		if ( hasExt( in, ".txt" ) )
+			ok = toBinary( in, base + ".dmo" );
+		else if ( hasExt( in, ".dmo" ) )
+			ok = toText( in, base + ".txt" );
+		else
+		{
+			fprintf( stderr, "'%s': unknown file type\n", in.c_str() );
+			ok = false;
+		}
+		if ( !ok )
+			ret = EXIT_FAILURE;
+	}
+	return ret;
+}
@@ -36,8 +36,10 @@
 #include <FL/Fl.H>
 #include <FL/fl_draw.H>
 #include <FL/fl_ask.H>
+#include <FL/x.H>	// Fl_Offscreen
 
 #include <cassert>
+#include <algorithm>
 #include <cmath>
 #include <string>
 #include <vector>
@@ -47,7 +49,8 @@
 using namespace std;
 
 static const unsigned MAX_LEVEL = 10;
-static const int MAX_SCREENS = 15;
+static const int MAX_SCREENS = 10000;	// sanity limit for -s
+static const int PREVIEW_SCREENS = 15;	// max. width of preview
 static const int DEF_SCREENS = 10;
 static const int SCREEN_W = 800;
 static const int SCREEN_H = 600;
@@ -256,12 +259,18 @@ public:
 	LSPoint() :
 		sky(-1),
 		ground(0),
-		object(0)
+		object(0),
+		bg_color(0),
+		ground_color(0),
+		sky_color(0)
 	{}
 	LSPoint( int ground_, int sky_ = -1, int object_ = 0 ) :
 		sky(sky_),
 		ground(ground_),
-		object(object_)
+		object(object_),
+		bg_color(0),
+		ground_color(0),
+		sky_color(0)
 	{}
 	int sky;
 	int ground;
@@ -272,13 +281,18 @@ public:
 };
 
 //-------------------------------------------------------------------------------
-class Terrain : public vector<LSPoint>
+class Terrain
 //-------------------------------------------------------------------------------
 {
-	typedef vector<LSPoint> Inherited;
+	// The columns are stored in chunks of CHUNK_W columns. A chunk is
+	// allocated when one of its columns is written, until then all its
+	// columns read as empty (LSPoint()). So empty parts of long levels
+	// (new or expanded levels, compressed runs) cost no memory.
+	typedef vector<LSPoint> Chunk;
 public:
+	enum { CHUNK_SHIFT = 12, CHUNK_W = 1 << CHUNK_SHIFT };
 	Terrain() :
-		Inherited(),
+		_size( 0 ),
 		bg_color( FL_BLUE ),
 		ground_color( FL_GREEN ),
 		sky_color( FL_DARK_GREEN ),
@@ -286,6 +300,52 @@ public:
 		outline_color_sky( FL_BLACK ),
 		outline_color_ground( FL_BLACK )
 	{}
+	size_t size() const { return _size; }
+	const LSPoint& operator[]( size_t x_ ) const
+	{
+		const Chunk& c = _chunks[ x_ >> CHUNK_SHIFT ];
+		return c.empty() ? _empty : c[ x_ & ( CHUNK_W - 1 ) ];
+	}
+	LSPoint& operator[]( size_t x_ )
+	{
+		Chunk& c = _chunks[ x_ >> CHUNK_SHIFT ];
+		if ( c.empty() )
+			c.resize( CHUNK_W );
+		return c[ x_ & ( CHUNK_W - 1 ) ];
+	}
+	LSPoint& back() { return (*this)[ _size - 1 ]; }
+	// append 'n_' columns 'p_'
+	void append( const LSPoint& p_, size_t n_ = 1 )
+	{
+		size_t x = _size;
+		resize( _size + n_ );
+		if ( !isEmpty( p_ ) )
+		{
+			for ( ; x < _size; x++ )
+				(*this)[ x ] = p_;
+		}
+	}
+	void resize( size_t size_ )
+	{
+		// clear columns cut off in the (new) last chunk
+		for ( size_t x = size_; x < _size && x >> CHUNK_SHIFT == size_ >> CHUNK_SHIFT; x++ )
+		{
+			if ( !_chunks[ x >> CHUNK_SHIFT ].empty() )
+				(*this)[ x ] = _empty;
+		}
+		_chunks.resize( ( size_ + CHUNK_W - 1 ) >> CHUNK_SHIFT );
+		_size = size_;
+	}
+	static bool isEmpty( const LSPoint& p_ )
+	{
+		return p_.sky == _empty.sky && p_.ground == _empty.ground &&
+		       p_.object == _empty.object && p_.bg_color == _empty.bg_color &&
+		       p_.ground_color == _empty.ground_color && p_.sky_color == _empty.sky_color;
+	}
+private:
+	static const LSPoint _empty;
+	vector<Chunk> _chunks;
+	size_t _size;
 public:
 	Fl_Color bg_color;
 	Fl_Color ground_color;
@@ -298,6 +358,9 @@ public:
 	vector<Fl_Color> alt_sky_colors;
 };
 
+/*static*/
+const LSPoint Terrain::_empty;
+
 static bool readColor( istream& s_, Fl_Color& c_ )
 //-------------------------------------------------------------------------------
 {
@@ -349,7 +412,7 @@ static ostream& writeColors( ostream& s_, Fl_Color c_, vector<Fl_Color> alt_ )
 		os << " ";
 		writeColor( os, alt_[i] );
 	}
-	s_ << os.str() << endl;
+	s_ << os.str() << '\n';
 	return s_;
 }
 
@@ -360,7 +423,9 @@ class LS
 public:
 	LS( size_t W_, const char *f_ = 0, bool *loaded_ = 0 ) :
 		_flags( 0 ),
-		_xoff( 0 )
+		_xoff( 0 ),
+		_dirtyFrom( 0 ),
+		_dirtyTo( -1 )
 	{
 		if ( loaded_ ) *loaded_ = false;
 		// Note: When W_ = 0 and a file is read in
@@ -403,25 +468,31 @@ public:
 						o = 0;
 					}
 					repeat++;
-					while ( repeat-- )
+					if ( o & O_COLOR_CHANGE )
 					{
-						if ( size() < W || ( !W_ && size() < MAX_SCREENS * SCREEN_W ) ) // access data is ignored!
-							_ls.push_back( LSPoint( g, s, o ) );
-						if ( o & O_COLOR_CHANGE )
+						// fetch extra data for color change object
+						Fl_Color bg_color, ground_color, sky_color;
+						readColor( f, bg_color );
+						readColor( f ,ground_color );
+						readColor( f, sky_color );
+						if ( f.good() && ( !W_ || size() < W ) )
 						{
-							// fetch extra data for color change object
-							Fl_Color bg_color, ground_color, sky_color;
-							readColor( f, bg_color );
-							readColor( f ,ground_color );
-							readColor( f, sky_color );
-							if ( f.good() && size() <= W )
-							{
-								_ls.back().bg_color = bg_color;
-								_ls.back().ground_color = ground_color;
-								_ls.back().sky_color = sky_color;
-							}
+							_objectColumns.push_back( size() );
+							_ls.append( LSPoint( g, s, o ) );
+							_ls.back().bg_color = bg_color;
+							_ls.back().ground_color = ground_color;
+							_ls.back().sky_color = sky_color;
 						}
+						continue;
+					}
+					if ( W_ && size() + repeat > W ) // access data is ignored!
+						repeat = size() < W ? (int)( W - size() ) : 0;
+					if ( o )
+					{
+						for ( int i = 0; i < repeat; i++ )
+							_objectColumns.push_back( size() + i );
 					}
+					_ls.append( LSPoint( g, s, o ), repeat );
 				}
 				f.clear(); 	// reset for reading of ini section
 				string line;
@@ -435,8 +506,8 @@ public:
 		// if W_ is specified, then it is expanded to W_
 		if ( ( size() && W_ ) || !size() )	// expand to W_
 		{
-			while ( size() < W )
-				_ls.push_back( LSPoint() );
+			if ( size() < W )
+				_ls.resize( W );
 		}
 	}
 	void setGround( int x_, int g_ )
@@ -444,6 +515,7 @@ public:
 		if ( x_ >= 0 && x_ < (int)size() )
 		{
 			_ls[ x_ ].ground = g_;
+			touch( x_, x_ );
 		}
 	}
 	void setSky( int x_, int s_ )
@@ -451,6 +523,7 @@ public:
 		if ( x_ >= 0 && x_ < (int)size() )
 		{
 			_ls[ x_ ].sky = s_;
+			touch( x_, x_ );
 		}
 	}
 	void setObject( int id_, int x_, bool set_ )
@@ -469,8 +542,19 @@ public:
 			}
 			else
 				_ls[ x_ ].object = _ls[ x_ ].object & ~id_;
+			indexObjects( x_ );
+		}
+	}
+	void setObjects( int x_, int objects_ )
+	{
+		if ( x_ >= 0 && x_ < (int)size() )
+		{
+			_ls[ x_ ].object = objects_;
+			indexObjects( x_ );
 		}
 	}
+	// sorted positions of all columns with objects
+	const vector<int>& objectColumns() const { return _objectColumns; }
 	string iniSection() const
 	{
 		ostringstream os;
@@ -479,6 +563,7 @@ public:
 		return os.str();
 	}
 	LSPoint& point( int x_ ) { return _ls[ x_ ]; }
+	const LSPoint& point( int x_ ) const { return _ls[ x_ ]; }
 	int ground( int x_ ) const { return _ls[ x_ ].ground; }
 	int sky( int x_ ) const { return _ls[ x_ ].sky; }
 	bool hasObject( int obj_, int x_ ) const { return _ls[ x_ ].object & obj_; }
@@ -496,25 +581,58 @@ public:
 	vector<Fl_Color> alt_bg_colors() const { return _ls.alt_bg_colors; }
 	vector<Fl_Color> alt_ground_colors() const { return _ls.alt_ground_colors; }
 	vector<Fl_Color> alt_sky_colors() const { return _ls.alt_sky_colors; }
-	void bg_color( Fl_Color bg_color_ ) { _ls.bg_color = bg_color_; }
-	void ground_color( Fl_Color ground_color_ ) { _ls.ground_color = ground_color_; }
-	void sky_color( Fl_Color sky_color_ ) { _ls.sky_color = sky_color_; }
+	void bg_color( Fl_Color bg_color_ ) { _ls.bg_color = bg_color_; touchAll(); }
+	void ground_color( Fl_Color ground_color_ ) { _ls.ground_color = ground_color_; touchAll(); }
+	void sky_color( Fl_Color sky_color_ ) { _ls.sky_color = sky_color_; touchAll(); }
 	unsigned outline_width() const { return _ls.outline_width; }
-	void outline_width( unsigned outline_width_ ) { _ls.outline_width = outline_width_; }
+	void outline_width( unsigned outline_width_ ) { _ls.outline_width = outline_width_; touchAll(); }
 	Fl_Color outline_color_ground() const { return _ls.outline_color_ground; }
 	Fl_Color outline_color_sky() const { return _ls.outline_color_sky; }
 	void outline_color_ground( Fl_Color outline_color_ground_ )
-	{ _ls.outline_color_ground = outline_color_ground_ ; }
+	{ _ls.outline_color_ground = outline_color_ground_ ; touchAll(); }
 	void outline_color_sky( Fl_Color outline_color_sky_ )
-	{ _ls.outline_color_sky = outline_color_sky_ ; }
+	{ _ls.outline_color_sky = outline_color_sky_ ; touchAll(); }
 	const Terrain& terrain() const { return _ls; }
 	unsigned long flags() const { return _flags; }
 	void xoff( int xoff_ ) { _xoff = xoff_; }
 	int xoff() const { return _xoff; }
+	// columns changed since last clean() (for the preview)
+	bool dirty( int& from_, int& to_ ) const
+	{
+		from_ = _dirtyFrom;
+		to_ = _dirtyTo;
+		return _dirtyTo >= _dirtyFrom;
+	}
+	void clean() { _dirtyFrom = 0; _dirtyTo = -1; }
+private:
+	void touch( int from_, int to_ )
+	{
+		if ( _dirtyTo < _dirtyFrom )
+		{
+			_dirtyFrom = from_;
+			_dirtyTo = to_;
+			return;
+		}
+		if ( from_ < _dirtyFrom ) _dirtyFrom = from_;
+		if ( to_ > _dirtyTo ) _dirtyTo = to_;
+	}
+	void touchAll() { touch( 0, (int)size() - 1 ); }
+	void indexObjects( int x_ )
+	{
+		vector<int>::iterator it = lower_bound( _objectColumns.begin(), _objectColumns.end(), x_ );
+		bool indexed = it != _objectColumns.end() && *it == x_;
+		if ( _ls[ x_ ].object && !indexed )
+			_objectColumns.insert( it, x_ );
+		else if ( !_ls[ x_ ].object && indexed )
+			_objectColumns.erase( it );
+	}
 private:
 	Terrain _ls;
 	unsigned long _flags;
 	int _xoff;
+	int _dirtyFrom;
+	int _dirtyTo;
+	vector<int> _objectColumns;
 	vector<string> _ini;
 };
 
@@ -526,11 +644,18 @@ class PreviewWindow : public Fl_Double_Window
 public:
 	static const double Scale;
 	PreviewWindow( int H_, LS *ls_ );
+	~PreviewWindow();
 private:
 	void draw();
 	int handle( int e_ );
+	bool follow();
+	void rasterize( int from_, int to_ );
+	int px( int x_ ) const { return lround( (double)( x_ - _origin ) / Scale ); }
+	int span() const { return (int)( w() * Scale ); }	// level columns shown
 private:
 	LS * _ls;
+	Fl_Offscreen _offscreen;	// rendered level part
+	int _origin;	// level column at left border
 };
 
 //--------------------------------------------------------------------------
@@ -541,7 +666,8 @@ class ZoomWindow : public Fl_Group
 public:
 	ZoomWindow( size_t sz_ );
 	int handle( int e_ );
-	void setPoint( int x_, int y_, Fl_Color c_ );
+	// RGB of pixel x_, y_ (0..sz-1)
+	unsigned char *pixel( int x_, int y_ ) { return &_rgb[ ( y_ * _sz + x_ ) * 3 ]; }
 	int sz() const { return _sz; }
 	void close()
 	{
@@ -561,16 +687,19 @@ public:
 			Inherited::hide();
 		}
 	}
-	void draw()
+	void draw();
+	bool hidden() const { return _hidden; }
+private:
+	Fl_Color pixelColor( int x_, int y_ )
 	{
-		Inherited::draw();
-		fl_rect( x(), y(), w(), h(), FL_BLACK );
-		fl_rect( x() + 1, y() + 1, w() - 2, h() - 2, FL_WHITE );
+		const unsigned char *p = pixel( x_, y_ );
+		return fl_rgb_color( p[0], p[1], p[2] );
 	}
-	bool hidden() const { return _hidden; }
 private:
 	int _sz;
 	bool _hidden;
+	vector<unsigned char> _rgb;	// sz x sz pixels
+	vector<unsigned char> _image;	// scaled up for drawing
 };
 
 //--------------------------------------------------------------------------
@@ -595,16 +724,218 @@ public:
 };
 
 //--------------------------------------------------------------------------
-struct UndoEntry
+class UndoRing
 //--------------------------------------------------------------------------
 {
-	UndoEntry( int type_, int xoff_, int value_ ) :
-		type( type_ ), xoff( xoff_ ) { value.push_back( value_ ); }
-	UndoEntry( int type_, int xoff_, vector<int>& value_ ) :
-		type( type_ ), xoff( xoff_ ), value( value_ ) {}
-	int type;
-	int xoff;
-	vector<int> value;
+	// Keeps the last edits of a level for undo/redo. An edit is stored as
+	// the range of changed columns with their data before and after the
+	// change (sky, ground, objects and marker colors, run length encoded)
+	// and optionally the level colors. The slots of the ring are reused,
+	// so the oldest edit is dropped in O(1), when the ring is full.
+	enum Channel
+	{
+		SKY, GROUND, OBJECT, BG_COLOR, GROUND_COLOR, SKY_COLOR, CHANNELS
+	};
+	struct Run
+	{
+		Run( int value_ ) : value( value_ ), length( 1 ) {}
+		int value;
+		int length;
+	};
+	typedef vector<Run> Runs;
+	struct Style
+	{
+		bool operator==( const Style& s_ ) const
+		{
+			return bg_color == s_.bg_color && ground_color == s_.ground_color &&
+			       sky_color == s_.sky_color && outline_width == s_.outline_width &&
+			       outline_color_sky == s_.outline_color_sky &&
+			       outline_color_ground == s_.outline_color_ground;
+		}
+		Fl_Color bg_color;
+		Fl_Color ground_color;
+		Fl_Color sky_color;
+		unsigned outline_width;
+		Fl_Color outline_color_sky;
+		Fl_Color outline_color_ground;
+	};
+	struct Command
+	{
+		void swap( Command& c_ )
+		{
+			std::swap( from, c_.from );
+			std::swap( to, c_.to );
+			std::swap( style, c_.style );
+			std::swap( styleBefore, c_.styleBefore );
+			std::swap( styleAfter, c_.styleAfter );
+			before.swap( c_.before );
+			after.swap( c_.after );
+		}
+		int from;	// changed columns [from, to]
+		int to;
+		bool style;	// level colors changed
+		Style styleBefore;
+		Style styleAfter;
+		Runs before;
+		Runs after;
+	};
+public:
+	UndoRing( size_t capacity_ ) :
+		_slots( capacity_ ),
+		_first( 0 ),
+		_count( 0 ),
+		_redo( 0 )
+	{
+	}
+	// Record an edit of columns from_..to_ (and of the level colors if
+	// style_): call begin() before changing the level and end() after.
+	void begin( const LS& ls_, int from_, int to_, bool style_ = false )
+	{
+		Command& c = _pending;
+		c.from = max( from_, 0 );
+		c.to = min( to_, (int)ls_.size() - 1 );
+		c.style = style_;
+		encode( ls_, c.from, c.to, c.before );
+		if ( style_ )
+			get( ls_, c.styleBefore );
+	}
+	void end( const LS& ls_ )
+	{
+		Command& c = _pending;
+		encode( ls_, c.from, c.to, c.after );
+		if ( c.style )
+			get( ls_, c.styleAfter );
+		if ( same( c.before, c.after ) && ( !c.style || c.styleBefore == c.styleAfter ) )
+			return;	// nothing changed
+		_redo = 0;
+		if ( _count == _slots.size() )
+		{
+			_first = ( _first + 1 ) % _slots.size();
+			_count--;
+		}
+		_slots[ ( _first + _count ) % _slots.size() ].swap( c );
+		_count++;
+	}
+	// Undo/redo the last edit, x_ is its first column (-1 for colors only).
+	bool undo( LS& ls_, int& x_ )
+	{
+		if ( !_count )
+			return false;
+		_count--;
+		_redo++;
+		const Command& c = _slots[ ( _first + _count ) % _slots.size() ];
+		decode( ls_, c.from, c.to, c.before );
+		if ( c.style )
+			set( ls_, c.styleBefore );
+		x_ = c.to >= c.from ? c.from : -1;
+		return true;
+	}
+	bool redo( LS& ls_, int& x_ )
+	{
+		if ( !_redo )
+			return false;
+		const Command& c = _slots[ ( _first + _count ) % _slots.size() ];
+		_count++;
+		_redo--;
+		decode( ls_, c.from, c.to, c.after );
+		if ( c.style )
+			set( ls_, c.styleAfter );
+		x_ = c.to >= c.from ? c.from : -1;
+		return true;
+	}
+	void clear() { _count = 0; _redo = 0; }
+private:
+	static int get( const LS& ls_, int channel_, int x_ )
+	{
+		const LSPoint& p = ls_.point( x_ );
+		switch ( channel_ )
+		{
+			case SKY: return p.sky;
+			case GROUND: return p.ground;
+			case OBJECT: return p.object;
+			case BG_COLOR: return (int)p.bg_color;
+			case GROUND_COLOR: return (int)p.ground_color;
+			default: return (int)p.sky_color;
+		}
+	}
+	static void set( LS& ls_, int channel_, int x_, int value_ )
+	{
+		switch ( channel_ )
+		{
+			case SKY: ls_.setSky( x_, value_ ); break;
+			case GROUND: ls_.setGround( x_, value_ ); break;
+			case OBJECT: ls_.setObjects( x_, value_ ); break;
+			case BG_COLOR: ls_.point( x_ ).bg_color = (Fl_Color)value_; break;
+			case GROUND_COLOR: ls_.point( x_ ).ground_color = (Fl_Color)value_; break;
+			default: ls_.point( x_ ).sky_color = (Fl_Color)value_;
+		}
+	}
+	static void get( const LS& ls_, Style& s_ )
+	{
+		s_.bg_color = ls_.bg_color();
+		s_.ground_color = ls_.ground_color();
+		s_.sky_color = ls_.sky_color();
+		s_.outline_width = ls_.outline_width();
+		s_.outline_color_sky = ls_.outline_color_sky();
+		s_.outline_color_ground = ls_.outline_color_ground();
+	}
+	static void set( LS& ls_, const Style& s_ )
+	{
+		ls_.bg_color( s_.bg_color );
+		ls_.ground_color( s_.ground_color );
+		ls_.sky_color( s_.sky_color );
+		ls_.outline_width( s_.outline_width );
+		ls_.outline_color_sky( s_.outline_color_sky );
+		ls_.outline_color_ground( s_.outline_color_ground );
+	}
+	// runs of all channels one after another
+	static void encode( const LS& ls_, int from_, int to_, Runs& runs_ )
+	{
+		runs_.clear();
+		for ( int c = 0; c < CHANNELS; c++ )
+		{
+			size_t start = runs_.size();
+			for ( int x = from_; x <= to_; x++ )
+			{
+				int v = get( ls_, c, x );
+				if ( runs_.size() > start && runs_.back().value == v )
+					runs_.back().length++;
+				else
+					runs_.push_back( Run( v ) );
+			}
+		}
+	}
+	static void decode( LS& ls_, int from_, int to_, const Runs& runs_ )
+	{
+		size_t r = 0;
+		for ( int c = 0; c < CHANNELS; c++ )
+		{
+			int x = from_;
+			while ( x <= to_ && r < runs_.size() )
+			{
+				const Run& run = runs_[ r++ ];
+				for ( int i = 0; i < run.length; i++ )
+					set( ls_, c, x++, run.value );
+			}
+		}
+	}
+	static bool same( const Runs& a_, const Runs& b_ )
+	{
+		if ( a_.size() != b_.size() )
+			return false;
+		for ( size_t i = 0; i < a_.size(); i++ )
+		{
+			if ( a_[i].value != b_[i].value || a_[i].length != b_[i].length )
+				return false;
+		}
+		return true;
+	}
+private:
+	vector<Command> _slots;
+	size_t _first;	// oldest edit
+	size_t _count;	// edits to undo
+	size_t _redo;	// undone edits after them (to redo)
+	Command _pending;
 };
 
 //--------------------------------------------------------------------------
@@ -626,6 +957,7 @@ public:
 	void placeObject( int obj_, int x_, int y_ );
 	void reloadImages();
 	void redraw();
+	void redrawColumns( int from_, int to_ );
 	void save();
 	int searchObject( int obj_, int x_, int y_ );
 	bool get_nearest_color_change_marker( int x_,
@@ -636,8 +968,9 @@ public:
 	void setTitle();
 	void showHelp();
 	void undo();
-	void undoPush( int type_, int xoff_, int value_ );
-	void undoPush( int type_, int xoff_, vector<int>& value_ );
+	void redo();
+	void showColumn( int x_ );
+	int colorChangeMarker( int x_ ) const;
 	void xoff( int xoff_ ) { _xoff = xoff_; }
 	int xoff() const { return _xoff; }
 	void onClose();
@@ -653,6 +986,19 @@ public:
 	bool dont_save() const { return _dont_save; }
 	void update_zoom( int x_, int y_ );
 private:
+	struct Sprite
+	{
+		int id;
+		Fl_Image *image;
+		int w;
+		int h;
+		bool clip;	// draw only w x h (first frame)
+		bool ground;	// stands on ground (else hangs from sky)
+		Fl_RGB_Image *mask;	// RGBA copy for the zoom
+	};
+	void damageColumns( int from_, int to_ );
+	void setupSprites();
+	void renderZoom( int x_, int y_ );
 	static void close_cb( Fl_Widget *wgt_, void *d_ ) { ((LSEditor *)d_)->onClose();	}
 	static void help_cb( Fl_Widget *o_, void *d_ ) { ((LSEditor *)d_)->showHelp();}
 	static void load_cb( Fl_Widget *o_, void *d_ )
@@ -683,6 +1029,10 @@ private:
 	Fl_Image *_cumulus;
 	Fl_Image *_radar;
 	Fl_Image *_phaser;
+	vector<Sprite> _sprites;
+	int _spriteW;	// max. sprite width
+	int _damageFrom;	// columns to repaint
+	int _damageTo;
 	int _objType;
 	bool _scrollLock;
 	int _last_x;
@@ -693,33 +1043,11 @@ private:
 	bool _menu_shown;
 	bool _dont_save;
 	bool _compress;
-	vector<UndoEntry> _undoStack;
+	UndoRing _undo;
 	Fl_Help_Dialog *_help;
 };
 
 
-//--------------------------------------------------------------------------
-class ZoomDot : public Fl_Box
-//--------------------------------------------------------------------------
-{
-	typedef Fl_Box Inherited;
-public:
-	ZoomDot( int x_, int y_, int w_, int h_ ) :
-		Inherited( x_, y_, w_, h_ )
-	{
-		box( FL_FLAT_BOX );
-	}
-	virtual void draw()
-	{
-		Inherited::draw();
-		if ( box() == FL_BORDER_BOX )
-		{
-			fl_color( fl_contrast( FL_BLACK, color() ) );
-			fl_rect( x(), y(), w(), h() );
-		}
-	}
-};
-
 //--------------------------------------------------------------------------
 // class ZoomWindow : public Fl_Group
 //--------------------------------------------------------------------------
@@ -727,28 +1055,44 @@ ZoomWindow::ZoomWindow( size_t sz_ ) :
 //--------------------------------------------------------------------------
 	Inherited( 0, 0, 20 * sz_ + 4, 20 * sz_ + 4, "Zoom" ),
 	_sz( sz_ ),
-	_hidden( false )
+	_hidden( false ),
+	_rgb( sz_ * sz_ * 3, 0 )
 {
-	int W = w() / sz_;
-	for ( int x = 0; x < _sz; x++ )
-	{
-		for ( int y = 0; y < _sz; y++ )
-		{
-			Fl_Box * b = new ZoomDot( x * W + 2, y * W + 2, W, W );
-			if ( x == _sz / 2 && y == _sz / 2 )
-				b->box( FL_BORDER_BOX );
-		}
-	}
 	box( FL_FLAT_BOX );
 	color( FL_BLACK );
 	end();
 }
 
-void ZoomWindow::setPoint( int x_, int y_, Fl_Color c_ )
+void ZoomWindow::draw()
 //--------------------------------------------------------------------------
 {
-	child( x_ * _sz + y_ )->color( c_ );
-	color( fl_contrast( FL_BLACK, child(0)->color() ) );	// keep border in contrast!
+	// draw the pixels as one image scaled up to D x D cells
+	const int D = ( w() - 4 ) / _sz;
+	const int W = D * _sz;
+	_image.resize( W * W * 3 );
+	for ( int y = 0; y < W; y++ )
+	{
+		const unsigned char *s = pixel( 0, y / D );
+		unsigned char *d = &_image[ y * W * 3 ];
+		for ( int x = 0; x < W; x++, d += 3 )
+		{
+			const unsigned char *p = s + x / D * 3;
+			d[0] = p[0];
+			d[1] = p[1];
+			d[2] = p[2];
+		}
+	}
+	fl_color( fl_contrast( FL_BLACK, pixelColor( 0, 0 ) ) );	// keep border in contrast!
+	fl_rectf( x(), y(), w(), h() );
+	fl_draw_image( &_image[0], x() + 2, y() + 2, W, W, 3 );
+
+	// mark center pixel
+	int c = _sz / 2;
+	fl_color( fl_contrast( FL_BLACK, pixelColor( c, c ) ) );
+	fl_rect( x() + 2 + c * D, y() + 2 + c * D, D, D );
+
+	fl_rect( x(), y(), w(), h(), FL_BLACK );
+	fl_rect( x() + 1, y() + 1, w() - 2, h() - 2, FL_WHITE );
 }
 
 int ZoomWindow::handle( int e_ )
@@ -772,8 +1116,11 @@ const double PreviewWindow::Scale = 10.;
 
 PreviewWindow::PreviewWindow( int H_, LS *ls_ ) :
 //--------------------------------------------------------------------------
-	Inherited( (int)( ls_->size() / Scale ), (int)( H_ / Scale ), ProgramName ),
-	_ls( ls_ )
+	Inherited( (int)( min( ls_->size(), (size_t)( PREVIEW_SCREENS * SCREEN_W ) ) / Scale ),
+	           (int)( H_ / Scale ), ProgramName ),
+	_ls( ls_ ),
+	_offscreen( 0 ),
+	_origin( 0 )
 {
 	ostringstream os;
 	os << label() << " Preview" << " 1 : " << (int)Scale;
@@ -782,68 +1129,125 @@ PreviewWindow::PreviewWindow( int H_, LS *ls_ ) :
 	show();
 }
 
-void PreviewWindow::draw()
+PreviewWindow::~PreviewWindow()
+//--------------------------------------------------------------------------
+{
+	if ( _offscreen )
+		fl_delete_offscreen( _offscreen );
+}
+
+void PreviewWindow::rasterize( int from_, int to_ )
 //--------------------------------------------------------------------------
 {
-	Inherited::draw();
+	// Render the part of the preview affected by the level columns
+	// from_..to_ (outlines connect the neighbours of a column).
+	// All lines touching this part are redrawn clipped to it.
+	int X0 = max( 0, px( from_ - 1 ) - 1 );
+	int X1 = min( w() - 1, px( to_ + 1 ) + 1 );
+	if ( X1 < X0 )
+		return;
+	int i0 = max( 0, _origin + (int)floor( ( X0 - 1 ) * Scale ) );
+	int i1 = min( (int)_ls->size() - 1, _origin + (int)ceil( ( X1 + 1 ) * Scale ) );
+	fl_push_clip( X0, 0, X1 - X0 + 1, h() );
+
 	fl_color( _ls->bg_color() );
-	fl_rectf( 0, 0, w(), h() );
+	fl_rectf( X0, 0, X1 - X0 + 1, h() );
 
 	fl_color( _ls->sky_color());
-	for ( int i = 0; i < (int)_ls->size(); i++ )
+	for ( int i = i0; i <= i1; i++ )
 	{
 		int S = _ls->sky( i );
 		if ( S >= 0 )
 		{
-			fl_line( lround( (double)i / Scale ), -1,
-			         lround( (double)i / Scale ), lround( (double)S / Scale ) );
+			fl_line( px( i ), -1, px( i ), lround( (double)S / Scale ) );
 		}
 	}
 
 	fl_color( _ls->ground_color() );
-	for ( int i = 0; i < (int)_ls->size(); i++ )
+	for ( int i = i0; i <= i1; i++ )
 	{
 		int G = _ls->ground( i );
-		fl_line( lround( (double)i / Scale ), h() - lround( (double)G / Scale ),
-		         lround( (double)i / Scale ), h() );
+		fl_line( px( i ), h() - lround( (double)G / Scale ), px( i ), h() );
 	}
 
 	// draw outline
 	if ( _ls->outline_width() )
 	{
+		int o0 = max( 1, i0 );
+		int o1 = min( (int)_ls->size() - 2, i1 );
 		fl_color( _ls->outline_color_sky() );
 		fl_line_style( FL_SOLID, 1 );
-		for ( int i = 1; i < (int)_ls->size() - 1; i++ )
+		for ( int i = o0; i <= o1; i++ )
 		{
 			if ( _ls->sky( i ) >= 0 )
 			{
 				int S0 = _ls->sky( i - 1 );
 				int S1 = _ls->sky( i + 1 );
-				fl_line( lround( (double)(i - 1) / Scale ),
-				         lround( (double)S0 / Scale ),
-				         lround( (double)(i + 1) / Scale ),
-				         lround( (double)S1 / Scale ) );
+				fl_line( px( i - 1 ), lround( (double)S0 / Scale ),
+				         px( i + 1 ), lround( (double)S1 / Scale ) );
 			}
 		}
 		fl_color( _ls->outline_color_ground() );
 #ifdef WIN32
 		fl_line_style( FL_SOLID, 1 );
 #endif
-		for ( int i = 1; i < (int)_ls->size() - 1; i++ )
+		for ( int i = o0; i <= o1; i++ )
 		{
 			int G0 = _ls->ground( i - 1 );
 			int G1 = _ls->ground( i + 1 );
-			fl_line( lround( (double)(i - 1) / Scale ),
-			         h() - lround( (double)G0 / Scale ),
-			         lround( (double)(i + 1) / Scale ),
-			         h() - lround( (double)G1 / Scale ) );
+			fl_line( px( i - 1 ), h() - lround( (double)G0 / Scale ),
+			         px( i + 1 ), h() - lround( (double)G1 / Scale ) );
 		}
 		fl_line_style( 0 );
 	}
+	fl_pop_clip();
+}
+
+bool PreviewWindow::follow()
+//--------------------------------------------------------------------------
+{
+	// Center the preview on the view, when the view leaves it
+	// (long levels are shown only partially).
+	int xoff = _ls->xoff();
+	if ( xoff >= _origin && xoff + SCREEN_W <= _origin + span() )
+		return false;
+	int origin = max( 0, min( xoff + SCREEN_W / 2 - span() / 2, (int)_ls->size() - span() ) );
+	origin -= origin % (int)Scale;	// keep pixel grid of level
+	if ( origin == _origin )
+		return false;
+	_origin = origin;
+	return true;
+}
+
+void PreviewWindow::draw()
+//--------------------------------------------------------------------------
+{
+	// The shown level part is rendered once into an offscreen image,
+	// afterwards only the changed columns are rendered again.
+	int from, to;
+	bool render = follow() || !_offscreen;
+	if ( !_offscreen )
+		_offscreen = fl_create_offscreen( w(), h() );
+	if ( render )
+	{
+		from = _origin;
+		to = _origin + span() - 1;
+	}
+	else
+		render = _ls->dirty( from, to );
+	_ls->clean();
+	if ( render )
+	{
+		fl_begin_offscreen( _offscreen );
+		rasterize( from, to );
+		fl_end_offscreen();
+	}
+	fl_copy_offscreen( 0, 0, w(), h(), _offscreen, 0, 0 );
+
 	// draw visible window hint
 	fl_color( FL_WHITE );
 	fl_line_style( FL_DOT );
-	fl_rect( lround( (double)_ls->xoff() / Scale ), 0,
+	fl_rect( px( _ls->xoff() ), 0,
 	         lround( (double)(SCREEN_W - 1) / Scale ), h() - 1 );
 	fl_line_style( 0 );
 }
@@ -868,7 +1272,7 @@ int PreviewWindow::handle( int e_ )
 				while ( win && win != dynamic_cast<LSEditor *>( win ) )
 					win = Fl::next_window( win );
 				if ( win )
-					((LSEditor *)win)->gotoXPos( (int)(x * Scale) );
+					((LSEditor *)win)->gotoXPos( _origin + (int)(x * Scale) );
 			}
 			break;
 	}
@@ -888,6 +1292,9 @@ LSEditor::LSEditor( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 	_drop( 0 ),
 	_bady( 0 ),
 	_cumulus( 0 ),
+	_spriteW( 0 ),
+	_damageFrom( 0 ),
+	_damageTo( -1 ),
 	_objType( 1 ),
 	_scrollLock( false ),
 	_last_x( -1 ),
@@ -898,6 +1305,7 @@ LSEditor::LSEditor( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 	_menu_shown( true ),
 	_dont_save( false ),
 	_compress( false ),
+	_undo( SCREEN_W ),
 	_help( 0 )
 //--------------------------------------------------------------------------
 {
@@ -999,12 +1407,7 @@ LSEditor::LSEditor( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 	objects.push_back( Object( O_COLOR_CHANGE, string(), "Color Change Marker" ) );
 	objects.back().w( 3 );
 	objects.back().h( h() );
-	_rocket = (Fl_Image *)objects.find( O_ROCKET )->image();
-	_drop = (Fl_Image *)objects.find( O_DROP )->image();
-	_bady = (Fl_Image *)objects.find( O_BADY )->image();
-	_cumulus = (Fl_Image *)objects.find( O_CUMULUS )->image();
-	_radar = (Fl_Image *)objects.find( O_RADAR )->image();
-	_phaser = (Fl_Image *)objects.find( O_PHASER )->image();
+	setupSprites();
 
 	if ( _mode == PLACE_OBJECTS )
 	{
@@ -1088,9 +1491,30 @@ void LSEditor::onClose()
 void LSEditor::draw()
 //--------------------------------------------------------------------------
 {
-	Inherited::draw();
+	// Edits only damage the changed columns (FL_DAMAGE_USER1), these are
+	// repainted clipped, with a margin for outlines, markers and sprites.
 	int H = SCREEN_H;
-	fl_push_clip( 0, 0, w(), SCREEN_H );
+	int X0 = 0;
+	int X1 = w() - 1;
+	bool partial = !( damage() & ~( FL_DAMAGE_USER1 | FL_DAMAGE_CHILD ) );
+	if ( partial )
+	{
+		int margin = 2 + max( (int)_ls->outline_width(), 2 ) + _spriteW / 2 + 1;
+		X0 = max( X0, _damageFrom - _xoff - margin );
+		X1 = min( X1, _damageTo - _xoff + margin );
+		if ( _damageTo < _damageFrom )
+			X1 = X0 - 1;	// only children damaged
+	}
+	_damageFrom = 0;
+	_damageTo = -1;
+	if ( !partial )
+		Inherited::draw();
+	else if ( X1 < X0 )
+	{
+		Inherited::draw_children();
+		return;
+	}
+	fl_push_clip( X0, 0, X1 - X0 + 1, SCREEN_H );
 
 	Fl_Color bg_color( _ls->bg_color() );
 	Fl_Color sky_color( _ls->sky_color() );
@@ -1098,17 +1522,21 @@ void LSEditor::draw()
 	get_nearest_color_change_marker( _xoff, sky_color, bg_color, ground_color );
 
 	fl_color( bg_color );
-	fl_rectf( 0, 0, w(), H );
+	fl_rectf( X0, 0, X1 - X0 + 1, H );
 	fl_color( sky_color );
 
-	for ( int i = _xoff; i < _xoff + w(); i++ )
+	// columns with lines into the clip area
+	int ow = _ls->outline_width();
+	int from = _xoff + max( X0 - 2 - ow, 0 );
+	int to = _xoff + min( X1 + 2 + ow, w() - 1 );
+	for ( int i = from; i <= to; i++ )
 	{
 		int S = _ls->sky( i );
 		fl_line( i - _xoff, -1, i - _xoff, S );
 	}
 
 	fl_color( ground_color );
-	for ( int i = _xoff; i < _xoff + w(); i++ )
+	for ( int i = from; i <= to; i++ )
 	{
 		int G = H - _ls->ground( i );
 		fl_line( i - _xoff, G, i - _xoff, H );
@@ -1117,9 +1545,11 @@ void LSEditor::draw()
 	// draw outline
 	if ( _ls->outline_width() )
 	{
+		int o0 = max( from, _xoff ? _xoff : 1 );
+		int o1 = min( to, _xoff + w() - 2 );
 		fl_color( _ls->outline_color_sky() );
 		fl_line_style( FL_SOLID, _ls->outline_width() );
-		for ( int i = ( _xoff ? _xoff : 1 ); i < _xoff + w() - 1; i++ )
+		for ( int i = o0; i <= o1; i++ )
 		{
 			if ( _ls->sky( i ) >= 0 )
 			{
@@ -1131,52 +1561,31 @@ void LSEditor::draw()
 #ifdef WIN32
 		fl_line_style( FL_SOLID, _ls->outline_width() );
 #endif
-		for ( int i = ( _xoff ? _xoff : 1 ); i < _xoff + w() - 1; i++ )
+		for ( int i = o0; i <= o1; i++ )
 			fl_line( i - _xoff - 1, H - _ls->ground( i  - 1 ),
 		            i - _xoff + 1, H - _ls->ground( i  + 1 ) );
 		fl_line_style( 0 );
 	}
 
-	for ( int i = _xoff; i < _xoff + w(); i++ )
+	// objects with sprites into the clip area (from the column index)
+	from = _xoff + max( X0 - _spriteW, 0 );
+	to = _xoff + min( X1 + _spriteW, w() - 1 );
+	const vector<int>& columns = _ls->objectColumns();
+	for ( vector<int>::const_iterator c = lower_bound( columns.begin(), columns.end(), from );
+	      c != columns.end() && *c <= to; ++c )
 	{
-		if ( _ls->hasRocket( i ) )
-		{
-			int G = H - _ls->ground( i );
-			if ( _rocket )
-				_rocket->draw( i - _xoff - _rocket->w() / 2, G - _rocket->h() );
-		}
-		if ( _ls->hasDrop( i ) )
-		{
-			int S = _ls->sky( i );
-			if ( _drop )
-				_drop->draw( i - _xoff - _drop->w() / 2, S  );
-		}
-		if ( _ls->hasBady( i ) )
-		{
-			int S = _ls->sky( i );
-			Object *o = objects.find( O_BADY );
-			if ( o )
-				o->image()->draw( i - _xoff - o->w() / 2, S, o->w(), o->h()  );
-		}
-		if ( _ls->hasCumulus( i ) )
-		{
-			int S = _ls->sky( i );
-			if ( _cumulus )
-				_cumulus->draw( i - _xoff - _cumulus->w() / 2, S  );
-		}
-		if ( _ls->hasRadar( i ) )
-		{
-			int G = H - _ls->ground( i );
-			Object *o = objects.find( O_RADAR );
-			if ( o )
-				o->image()->draw( i - _xoff - o->w() / 2, G - o->h(), o->w(), o->h() );
-		}
-		if ( _ls->hasPhaser( i ) )
+		int i = *c;
+		for ( size_t j = 0; j < _sprites.size(); j++ )
 		{
-			int G = H - _ls->ground( i );
-			Object *o = objects.find( O_PHASER );
-			if ( o )
-				o->image()->draw( i - _xoff - o->w() / 2, G - o->h(), o->w(), o->h() );
+			const Sprite& s = _sprites[j];
+			if ( !_ls->hasObject( s.id, i ) )
+				continue;
+			int X = i - _xoff - s.w / 2;
+			int Y = s.ground ? H - _ls->ground( i ) - s.h : _ls->sky( i );
+			if ( s.clip )
+				s.image->draw( X, Y, s.w, s.h );
+			else
+				s.image->draw( X, Y );
 		}
 		if ( _ls->hasObject( O_COLOR_CHANGE, i ) )
 		{
@@ -1196,67 +1605,156 @@ void LSEditor::update_zoom( int x_, int y_ )
 	if ( !_zoom || _zoom->hidden() || !_zoom->visible_r() )
 		return;
 	const int sz = _zoom->sz();
-	int X(  x_ - sz / 2 );
-	int Y(  y_ - sz / 2 );
-	int H = sz;
-	int W = sz;
-	if ( Y < 0 )
-	{
-		H += Y;
-		Y = 0;
-	}
-	if ( X < 0 )
-	{
-		W += X;
-		X = 0;
-	}
-	int EX = w() - ( X +  W);
-	if ( EX <  0 )
-	{
-		W += EX;
-	}
-	int EY = h() - ( Y +  H);
-	if ( EY <  0 )
+	renderZoom( x_ - sz / 2, y_ - sz / 2 );
+
+	int X = x_ + 30;
+	int Y = y_ + 30;
+	if ( X + _zoom->w() >= this->w() )
+		X = x_ - _zoom->w() - 30;
+	if ( Y + _zoom->h() >= this->h() - 20 )
+		Y = y_ - _zoom->h() - 30;
+	int ox = _zoom->x();
+	_zoom->position( X, Y );
+	damageColumns( _xoff + min( ox, X ), _xoff + max( ox, X ) + _zoom->w() );
+}
+
+static bool onLine( int x_, int y_, int x0_, int y0_, int x1_, int y1_, unsigned w_ )
+//--------------------------------------------------------------------------
+{
+	// is pixel x_, y_ on the line x0_, y0_ - x1_, y1_ of width w_?
+	// (distance from the line, close to what the X server draws)
+	double dx = x1_ - x0_;
+	double dy = y1_ - y0_;
+	double l = dx * dx + dy * dy;
+	double t = l ? ( ( x_ - x0_ ) * dx + ( y_ - y0_ ) * dy ) / l : 0.;
+	t = max( 0., min( 1., t ) );
+	double ex = x0_ + t * dx - x_;
+	double ey = y0_ + t * dy - y_;
+	double r = max( w_, 1u ) / 2. + 0.2;
+	return ex * ex + ey * ey <= r * r;
+}
+
+static void setRGB( unsigned char *p_, Fl_Color c_ )
+//--------------------------------------------------------------------------
+{
+	Fl::get_color( c_, p_[0], p_[1], p_[2] );
+}
+
+void LSEditor::renderZoom( int x_, int y_ )
+//--------------------------------------------------------------------------
+{
+	// Render the sz x sz pixels of the view at x_, y_ like draw() does,
+	// but directly from the level and the sprite masks into the zoom
+	// (no read back from the screen).
+	const int sz = _zoom->sz();
+	const int H = SCREEN_H;
+	Fl_Color bg_color( _ls->bg_color() );
+	Fl_Color sky_color( _ls->sky_color() );
+	Fl_Color ground_color( _ls->ground_color() );
+	get_nearest_color_change_marker( _xoff, sky_color, bg_color, ground_color );
+
+	// visible columns of the level (in view coordinates)
+	int X0 = 0;
+	int X1 = min( w(), (int)_ls->size() - _xoff ) - 1;
+	// zoom pixels xa..xb-1, ya..yb-1 show the level, the rest is black
+	int xa = max( 0, X0 - x_ );
+	int xb = min( sz, X1 + 1 - x_ );
+	int ya = max( 0, -y_ );
+	int yb = min( sz, H - y_ );
+
+	for ( int x = 0; x < sz; x++ )
 	{
-		H += EX;
+		int i = _xoff + x_ + x;
+		for ( int y = 0; y < sz; y++ )
+		{
+			int Y = y_ + y;
+			Fl_Color c = bg_color;
+			if ( x < xa || x >= xb || y < ya || y >= yb )
+				c = FL_BLACK;
+			else if ( Y >= H - _ls->ground( i ) )
+				c = ground_color;
+			else if ( Y <= _ls->sky( i ) )
+				c = sky_color;
+			setRGB( _zoom->pixel( x, y ), c );
+		}
 	}
-	if ( H <= 0 || W <= 0 )
-		return;
-	make_current();
-	const uchar *screen = fl_read_image( 0, X, Y, W, H );
-	if ( !screen )
+
+	// outline segments reaching into the zoom
+	unsigned ow = _ls->outline_width();
+	if ( ow )
 	{
-		return;
+		int r = 2 + (int)ow;
+		int o0 = max( max( x_ - r, X0 ), _xoff ? 0 : 1 );
+		int o1 = min( x_ + sz + r, X1 - 1 );
+		unsigned char rgb[2][3];
+		setRGB( rgb[0], _ls->outline_color_sky() );
+		setRGB( rgb[1], _ls->outline_color_ground() );
+		for ( int ground = 0; ground < 2; ground++ )
+		{
+			for ( int X = o0; X <= o1; X++ )
+			{
+				int i = _xoff + X;
+				if ( !ground && _ls->sky( i ) < 0 )
+					continue;
+				int y0 = ground ? H - _ls->ground( i - 1 ) : _ls->sky( i - 1 );
+				int y1 = ground ? H - _ls->ground( i + 1 ) : _ls->sky( i + 1 );
+				for ( int x = xa; x < xb; x++ )
+				{
+					for ( int y = ya; y < yb; y++ )
+					{
+						if ( onLine( x_ + x, y_ + y, X - 1, y0, X + 1, y1, ow ) )
+							memcpy( _zoom->pixel( x, y ), rgb[ground], 3 );
+					}
+				}
+			}
+		}
 	}
 
-	const int d = 3;
-	unsigned char r, g, b;
-
-	for ( int y = 0; y < H; y++ ) // lines
+	// objects reaching into the zoom, in the order of draw()
+	const vector<int>& columns = _ls->objectColumns();
+	int from = _xoff + max( x_ - _spriteW, X0 );
+	int to = _xoff + min( x_ + sz + _spriteW, X1 );
+	for ( vector<int>::const_iterator c = lower_bound( columns.begin(), columns.end(), from );
+	      c != columns.end() && *c <= to; ++c )
 	{
-		long index = y * W * d; // line start offset
-		for ( int x = 0; x < W; x++ )
+		int i = *c;
+		for ( size_t j = 0; j < _sprites.size(); j++ )
 		{
-			r = *(screen + index + 0);
-			g = *(screen + index + 1);
-			b = *(screen + index + 2);
-
-//			printf( "%02X%02X%02X ", r, g, b );
-			_zoom->setPoint( x, y, fl_rgb_color( r, g, b ) );
-
-			index += d;
+			const Sprite& s = _sprites[j];
+			if ( !_ls->hasObject( s.id, i ) || !s.mask || s.mask->d() < 3 )
+				continue;
+			int SX = i - _xoff - s.w / 2;
+			int SY = s.ground ? H - _ls->ground( i ) - s.h : _ls->sky( i );
+			const int d = s.mask->d();
+			const int ld = s.mask->ld() ? s.mask->ld() : s.mask->w() * d;
+			const unsigned char *data = (const unsigned char *)s.mask->data()[0];
+			for ( int x = max( xa, SX - x_ ); x < min( xb, SX + s.w - x_ ); x++ )
+			{
+				for ( int y = max( ya, SY - y_ ); y < min( yb, SY + s.h - y_ ); y++ )
+				{
+					const unsigned char *m = data + ( y_ + y - SY ) * ld + ( x_ + x - SX ) * d;
+					unsigned a = d == 4 ? m[3] : 255;
+					unsigned char *p = _zoom->pixel( x, y );
+					for ( int k = 0; k < 3; k++ )
+						p[k] = ( m[k] * a + p[k] * ( 255 - a ) ) / 255;
+				}
+			}
+		}
+		if ( _ls->hasObject( O_COLOR_CHANGE, i ) )
+		{
+			// dotted line of width 4 (4 on, 4 off)
+			int X = i - _xoff;
+			for ( int x = max( xa, X - 2 - x_ ); x < min( xb, X + 2 - x_ ); x++ )
+			{
+				for ( int y = ya; y < yb; y++ )
+				{
+					if ( ( ( y_ + y ) / 4 ) % 2 == 0 )
+						setRGB( _zoom->pixel( x, y ), FL_RED );
+				}
+			}
 		}
-//		printf( "\n");
 	}
-	X = x_ + 30;
-	Y = y_ + 30;
-	if ( X + _zoom->w() >= this->w() )
-		X = x_ - _zoom->w() - 30;
-	if ( Y + _zoom->h() >= this->h() - 20 )
-		Y = y_ - _zoom->h() - 30;
-	_zoom->position( X, Y );
-	_zoom->window()->redraw();
-	delete[] screen;
+	_zoom->redraw();
 }
 
 void LSEditor::drawLine( int x0_, int y0_, int x1_, int y1_, bool ground_ )
@@ -1273,28 +1771,24 @@ void LSEditor::drawLine( int x0_, int y0_, int x1_, int y1_, bool ground_ )
 	}
 	int dx = x1_ - x0_;
 	int dy = y1_ - y0_;
+	_undo.begin( *_ls, x0_, x0_ + dx - 1 );
 	if ( ground_ )
 	{
-		vector<int> undo;
 		for ( int x = 0; x < dx; x++ )
 		{
 			int y = y0_ + ( (double)dy / dx ) * x;
-			undo.push_back( _ls->ground( x0_ + x ) );
 			_ls->setGround( x0_ + x, SCREEN_H - y );
 		}
-		undoPush( 0, x0_, undo );
 	}
 	else
 	{
-		vector<int> undo;
 		for ( int x = 0; x < dx; x++ )
 		{
 			int y = y0_ + ( (double)dy / dx ) * x;
-			undo.push_back( _ls->sky( x0_ + x ) );
 			_ls->setSky( x0_ + x, y );
 		}
-		undoPush( 1, x0_, undo );
 	}
+	_undo.end( *_ls );
 }
 
 int LSEditor::handle( int e_ )
@@ -1352,7 +1846,9 @@ int LSEditor::handle( int e_ )
 				unsigned ow = _ls->outline_width();
 				ow++;
 				ow %= 5;
+				_undo.begin( *_ls, 0, -1, true );
 				_ls->outline_width( ow );
+				_undo.end( *_ls );
 				changed( true );
 				redraw();
 			}
@@ -1437,7 +1933,7 @@ int LSEditor::handle( int e_ )
 
 			if ( FL_Delete == key || FL_BackSpace == key )
 			{
-				undo();
+				Fl::event_shift() ? redo() : undo();
 			}
 
 			setTitle();
@@ -1506,26 +2002,22 @@ int LSEditor::handle( int e_ )
 						{
 							// draw line from last position to current position
 							drawLine( _last_x, _last_y, _xoff + x, y, ground );
+							redrawColumns( min( _last_x, _xoff + x ), max( _last_x, _xoff + x ) );
 							_last_x = _xoff + x;
 							_last_y = y;
-							redraw();
 							break;
 						}
 						_last_x = _xoff + x;
 						_last_y = y;
 						// pixel mode for fine adjustments
+						_undo.begin( *_ls, _xoff + x, _xoff + x );
 						if ( ground )
-						{
-							undoPush( 0, _xoff + x, _ls->ground( _xoff + x ) );
 							_ls->setGround( _xoff + x, SCREEN_H - y );
-						}
 						else
-						{
-							undoPush( 1, _xoff + x, _ls->sky( _xoff + x ) );
 							_ls->setSky( _xoff + x, y );
-						}
+						_undo.end( *_ls );
 
-						redraw();
+						redrawColumns( _xoff + x, _xoff + x );
 					}
 				}
 			}
@@ -1555,31 +2047,24 @@ int LSEditor::handle( int e_ )
 						x1 = xo;
 				}
 				int Y = snap_to_y != -1 ? snap_to_y : y;
-				vector<int> value;
+				if ( x1 > x0 )
+					_undo.begin( *_ls, _xoff + x0, _xoff + x1 - 1 );
 				for ( int X = x0; X < x1; X++ )
 				{
 					if ( ground )
-					{
-						value.push_back( _ls->ground( _xoff + X ) );
 						_ls->setGround( _xoff + X, SCREEN_H - Y );
-					}
 					else
-					{
-						value.push_back( _ls->sky( _xoff + X ) );
 						_ls->setSky( _xoff + X, Y );
-					}
 
 					changed( true );
 				}
-				if ( value.size() )
-				{
-					undoPush( !ground, _xoff + x0, value );
-				}
+				if ( x1 > x0 )
+					_undo.end( *_ls );
 				xo = x;
+				int xoff = _xoff;
 				if ( _scrollLock || Fl::event_shift() )
 				{
 					// exp. autoscroll
-					int xoff = _xoff;
 #if 0
 					if ( x > w() - w() / 4 )
 						_xoff += w() / 128;
@@ -1595,7 +2080,10 @@ int LSEditor::handle( int e_ )
 					xo = x - scrolled;
 					setTitle();
 				}
-				redraw();
+				if ( _xoff != xoff )
+					redraw();
+				else
+					redrawColumns( _xoff + x0, _xoff + x1 );
 			}
 			break;
 		case FL_RELEASE:
@@ -1651,6 +2139,7 @@ void LSEditor::onLoad( int level_/*= 0*/ )
 		delete _ls;
 		_ls = ls;
 		_xoff = 0;
+		_undo.clear();
 		delete _preview;
 		_preview = new PreviewWindow( SCREEN_H, _ls );
 		_slider->reset( w(), _ls->size() );
@@ -1703,6 +2192,8 @@ void LSEditor::placeObject( int obj_, int x_, int y_ )
 {
 	int X = _xoff + x_;
 	int x = searchObject( obj_, x_, y_ );
+	int col = x ? x - 1 : X;
+	_undo.begin( *_ls, col, col );
 	if ( x )
 	{
 		_ls->setObject( obj_, x - 1, false );
@@ -1711,8 +2202,12 @@ void LSEditor::placeObject( int obj_, int x_, int y_ )
 	{
 		_ls->setObject( obj_, X, true );
 	}
+	_undo.end( *_ls );
 	changed( true );
-	redraw();
+	if ( obj_ == O_COLOR_CHANGE )
+		redraw();	// colors of view may change
+	else
+		redrawColumns( col, col );
 }
 
 void LSEditor::reloadImages()
@@ -1720,12 +2215,75 @@ void LSEditor::reloadImages()
 {
 	for ( size_t i = 0; i < objects.size();  i++ )
 		objects[i].image( objects[i].imageName().c_str() );
+	setupSprites();
+}
+
+void LSEditor::setupSprites()
+//--------------------------------------------------------------------------
+{
 	_rocket = (Fl_Image *)objects.find( O_ROCKET )->image();
 	_drop = (Fl_Image *)objects.find( O_DROP )->image();
 	_bady = (Fl_Image *)objects.find( O_BADY )->image();
 	_cumulus = (Fl_Image *)objects.find( O_CUMULUS )->image();
 	_radar = (Fl_Image *)objects.find( O_RADAR )->image();
 	_phaser = (Fl_Image *)objects.find( O_PHASER )->image();
+
+	// object images in drawing order
+	static const struct { int id; bool clip; bool ground; } types[] =
+	{
+		{ O_ROCKET, false, true },
+		{ O_DROP, false, false },
+		{ O_BADY, true, false },
+		{ O_CUMULUS, false, false },
+		{ O_RADAR, true, true },
+		{ O_PHASER, true, true }
+	};
+	for ( size_t i = 0; i < _sprites.size(); i++ )
+		delete _sprites[i].mask;
+	_sprites.clear();
+	_spriteW = 0;
+	for ( size_t i = 0; i < sizeof( types ) / sizeof( types[0] ); i++ )
+	{
+		Object *o = objects.find( types[i].id );
+		if ( !o || !o->image() )
+			continue;
+		Sprite s;
+		s.id = types[i].id;
+		s.image = o->image();
+		s.w = types[i].clip ? o->w() : s.image->w();
+		s.h = types[i].clip ? o->h() : s.image->h();
+		s.clip = types[i].clip;
+		s.ground = types[i].ground;
+		s.mask = new Fl_RGB_Image( (Fl_Pixmap *)s.image );
+		_sprites.push_back( s );
+		_spriteW = max( _spriteW, s.w );
+	}
+}
+
+void LSEditor::damageColumns( int from_, int to_ )
+//--------------------------------------------------------------------------
+{
+	if ( _damageTo < _damageFrom )
+	{
+		_damageFrom = from_;
+		_damageTo = to_;
+	}
+	else
+	{
+		_damageFrom = min( _damageFrom, from_ );
+		_damageTo = max( _damageTo, to_ );
+	}
+	damage( FL_DAMAGE_USER1 );
+}
+
+void LSEditor::redrawColumns( int from_, int to_ )
+//--------------------------------------------------------------------------
+{
+	// like redraw(), but only repaint the level columns from_..to_
+	damageColumns( from_, to_ );
+	if ( _preview )
+		_preview->redraw();
+	update_zoom( Fl::event_x(), Fl::event_y() );
 }
 
 void LSEditor::redraw()
@@ -1746,13 +2304,17 @@ void LSEditor::save()
 	if ( name.empty() )
 		name = "_ls.txt";
 	cout << "saving" << ( _compress ? " compressed" : "" ) << " to " << name.c_str() << endl;
-	ofstream f( name.c_str() );
-	f << 1 << endl;	// version
-	f << _ls->flags() << endl;	// preserved flags (only hand-editable currently)
+	// write through a large buffer, lines end with '\n' (not flushing endl)
+	static char buf[ 64 * 1024 ];
+	ofstream f;
+	f.rdbuf()->pubsetbuf( buf, sizeof( buf ) );
+	f.open( name.c_str() );
+	f << 1 << '\n';	// version
+	f << _ls->flags() << '\n';	// preserved flags (only hand-editable currently)
 	// new format
-	f << _ls->outline_width() << endl;
-	writeColor( f, _ls->outline_color_ground() ) << endl;
-	writeColor( f, _ls->outline_color_sky() ) << endl;
+	f << _ls->outline_width() << '\n';
+	writeColor( f, _ls->outline_color_ground() ) << '\n';
+	writeColor( f, _ls->outline_color_sky() ) << '\n';
 
 	writeColors( f, _ls->bg_color(), _ls->alt_bg_colors() );
 	writeColors( f, _ls->ground_color(), _ls->alt_ground_colors() );
@@ -1783,10 +2345,16 @@ void LSEditor::save()
 			f << " "; writeColor( f, _ls->point(i).ground_color );
 			f << " "; writeColor( f, _ls->point(i).sky_color );
 		}
-		f << endl;
+		f << '\n';
 	}
 	// write ini section
 	f << _ls->iniSection();
+	f.close();
+	if ( f.fail() )
+	{
+		cerr << "error saving to " << name.c_str() << endl;
+		return;
+	}
 	changed( false );
 }
 
@@ -1814,51 +2382,56 @@ int LSEditor::searchObject( int obj_, int x_, int y_ )
 	return 0;
 }
 
-bool LSEditor::get_nearest_color_change_marker( int x_,
-      Fl_Color& sky_color_, Fl_Color& bg_color_, Fl_Color& ground_color_ )
+int LSEditor::colorChangeMarker( int x_ ) const
 //--------------------------------------------------------------------------
 {
-	int X( x_ );
-	while ( X > 0 )
+	// position of nearest color change marker left of x_ (0 = none)
+	const vector<int>& columns = _ls->objectColumns();
+	vector<int>::const_iterator it = upper_bound( columns.begin(), columns.end(), x_ );
+	while ( it != columns.begin() )
 	{
+		int X = *--it;
+		if ( X <= 0 )
+			break;
 		if ( _ls->hasObject( O_COLOR_CHANGE, X ) )
-		{
-			// Hack: access points directly - to much hassle otherwise
-			sky_color_ = _ls->point( X ).sky_color;
-			bg_color_ = _ls->point( X ).bg_color;
-			ground_color_ = _ls->point( X ).ground_color;
-			if ( !sky_color_ && !bg_color_ && !ground_color_ )
-			{
-				// a "restore" object (0/0/0) => change to original colors
-				sky_color_ = _ls->sky_color();
-				bg_color_ = _ls->bg_color();
-				ground_color_ = _ls->ground_color();
-			}
-			return true;
-		}
-		--X;
+			return X;
 	}
-	return false;
+	return 0;
+}
+
+bool LSEditor::get_nearest_color_change_marker( int x_,
+      Fl_Color& sky_color_, Fl_Color& bg_color_, Fl_Color& ground_color_ )
+//--------------------------------------------------------------------------
+{
+	int X = colorChangeMarker( x_ );
+	if ( !X )
+		return false;
+	// Hack: access points directly - to much hassle otherwise
+	sky_color_ = _ls->point( X ).sky_color;
+	bg_color_ = _ls->point( X ).bg_color;
+	ground_color_ = _ls->point( X ).ground_color;
+	if ( !sky_color_ && !bg_color_ && !ground_color_ )
+	{
+		// a "restore" object (0/0/0) => change to original colors
+		sky_color_ = _ls->sky_color();
+		bg_color_ = _ls->bg_color();
+		ground_color_ = _ls->ground_color();
+	}
+	return true;
 }
 
 bool LSEditor::set_nearest_color_change_marker( int x_,
       Fl_Color& sky_color_, Fl_Color& bg_color_, Fl_Color& ground_color_ )
 //--------------------------------------------------------------------------
 {
-	int X( x_ );
-	while ( X > 0 )
-	{
-		if ( _ls->hasObject( O_COLOR_CHANGE, X ) )
-		{
-			// Hack: access points directly - to much hassle otherwise
-			_ls->point( X ).sky_color = sky_color_;
-			_ls->point( X ).bg_color = bg_color_;
-			_ls->point( X ).ground_color = ground_color_;
-			return true;
-		}
-		--X;
-	}
-	return false;
+	int X = colorChangeMarker( x_ );
+	if ( !X )
+		return false;
+	// Hack: access points directly - to much hassle otherwise
+	_ls->point( X ).sky_color = sky_color_;
+	_ls->point( X ).bg_color = bg_color_;
+	_ls->point( X ).ground_color = ground_color_;
+	return true;
 }
 
 void LSEditor::selectColor( int x_, int y_ )
@@ -1907,6 +2480,8 @@ void LSEditor::selectColor( int x_, int y_ )
 	if ( fl_color_chooser( prompt.c_str(), r, g, b, 1 ) )
 	{
 		Fl_Color nc = fl_rgb_color( r, g, b );
+		int M = colorChangeMarker( X );
+		_undo.begin( *_ls, M, M, true );
 		if ( m == SKY )
 			sky_color =  nc;
 		else if ( m == GROUND )
@@ -1923,6 +2498,7 @@ void LSEditor::selectColor( int x_, int y_ )
 			_ls->ground_color( ground_color );
 			_ls->bg_color( bg_color );
 		}
+		_undo.end( *_ls );
 		redraw();
 		changed( true );
 	}
@@ -1992,25 +2568,29 @@ void LSEditor::showHelp()
 	_help->show();
 }
 
+void LSEditor::showColumn( int x_ )
+//--------------------------------------------------------------------------
+{
+	// scroll column x_ into view
+	if ( x_ < 0 )
+		return;
+	if ( x_ > _xoff + SCREEN_W - SCREEN_W / 6 || x_ < _xoff )
+		_xoff = x_ - SCREEN_W / 2;
+	if ( _xoff + w() > (int)_ls->size() )
+		_xoff = _ls->size() - w();
+	if ( _xoff < 0 )
+		_xoff = 0;
+}
+
 void LSEditor::undo()
 //--------------------------------------------------------------------------
 {
-	if ( _undoStack.size() )
-	{
-		UndoEntry u = _undoStack.back();
-		_undoStack.pop_back();
-		int x = u.xoff;
-		if ( x > _xoff + SCREEN_W - SCREEN_W / 6 || x < _xoff )
-			_xoff = x - SCREEN_W / 2;
-		if ( _xoff < 0 )
-			_xoff = 0;
-		for ( size_t i = 0; i < u.value.size(); i++ )
-		{
-			if ( u.type == 0 )
-				_ls->setGround( x + i, u.value[i] );
-			else if ( u.type == 1 )
-				_ls->setSky( x + i, u.value[i] );
-		}
+	int x;
+	if ( _undo.undo( *_ls, x ) )
+	{
+		showColumn( x );
+		changed( true );
+		setTitle();
 		redraw();
 	}
 	else
@@ -2019,20 +2599,21 @@ void LSEditor::undo()
 	}
 }
 
-void LSEditor::undoPush( int type_, int xoff_, int value_ )
-//--------------------------------------------------------------------------
-{
-	_undoStack.push_back( UndoEntry( type_, xoff_, value_ ) );
-	while ( (int)_undoStack.size() > SCREEN_W )
-		_undoStack.erase( _undoStack.begin() );
-}
-
-void LSEditor::undoPush( int type_, int xoff_, vector<int>& value_ )
+void LSEditor::redo()
 //--------------------------------------------------------------------------
 {
-	_undoStack.push_back( UndoEntry( type_, xoff_, value_ ) );
-	while ( (int)_undoStack.size() > SCREEN_W )
-		_undoStack.erase( _undoStack.begin() );
+	int x;
+	if ( _undo.redo( *_ls, x ) )
+	{
+		showColumn( x );
+		changed( true );
+		setTitle();
+		redraw();
+	}
+	else
+	{
+		fl_alert( "Nothing (more) to redo." );
+	}
 }
 
 #ifdef WIN32
@@ -0,0 +1,215 @@
+//
+// Copyright 2015-2016 Christian Grabner.
+//
+// This file is part of FLTrator.
+//
+// FLTrator is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation,  either version 3 of the License, or
+// (at your option) any later version.
+//
+// FLTrator is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY;  without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details:
+// http://www.gnu.org/licenses/.
+//
+//  Builds the asset pack 'fltrator.pak' (see asset_pack.H) from the
+//  resource directory layout:
+//
+//    images/**/*.gif|png, levels/**/*.txt, demo/*.txt|dmo, lang_*.txt
+//
+//  Sounds are not packed, as they are played from file by an
+//  external player.
+//
+#include "asset_pack.H"
+
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+struct File
+{
+	string name;	// relative to root dir
+	vector<char> data;
+};
+
+static bool hasExt( const string& name_, const char *ext_ )
+{
+	size_t len = strlen( ext_ );
+	return name_.size() > len && name_.compare( name_.size() - len, len, ext_ ) == 0;
+}
+
+static bool readFile( const string& path_, vector<char>& data_ )
+{
+	FILE *f = fopen( path_.c_str(), "rb" );
+	if ( !f )
+		return false;
+	fseek( f, 0, SEEK_END );
+	long size = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	data_.resize( size );
+	bool ok = size == 0 || fread( &data_[0], size, 1, f ) == 1;
+	fclose( f );
+	return ok;
+}
+
+static void collect( const string& root_, const string& dir_, const char *exts_[],
+                     bool recursive_, const char *prefix_, vector<File>& files_ )
+{
+	DIR *d = opendir( ( root_ + dir_ ).c_str() );
+	if ( !d )
+		return;
+	vector<string> names;
+	while ( dirent *e = readdir( d ) )
+		names.push_back( e->d_name );
+	closedir( d );
+	sort( names.begin(), names.end() );	// reproducible pack
+
+	for ( size_t i = 0; i < names.size(); i++ )
+	{
+		const string& name = names[i];
+		if ( name[0] == '.' )
+			continue;
+		string rel( dir_ + name );
+		struct stat st;
+		if ( stat( ( root_ + rel ).c_str(), &st ) != 0 )
+			continue;
+		if ( S_ISDIR( st.st_mode ) )
+		{
+			if ( recursive_ )
+				collect( root_, rel + "/", exts_, recursive_, prefix_, files_ );
+			continue;
+		}
+		if ( prefix_ && name.compare( 0, strlen( prefix_ ), prefix_ ) != 0 )
+			continue;
+		bool match = false;
+		for ( size_t j = 0; exts_[j] && !match; j++ )
+			match = hasExt( name, exts_[j] );
+		if ( !match )
+			continue;
+		File f;
+		f.name = rel;
+		if ( !readFile( root_ + rel, f.data ) )
+		{
+			fprintf( stderr, "can't read '%s'\n", ( root_ + rel ).c_str() );
+			exit( EXIT_FAILURE );
+		}
+		files_.push_back( f );
+	}
+}
+
+static bool writePack( const string& name_, const vector<File>& files_ )
+{
+	PackHeader hdr;
+	memcpy( hdr.magic, PACK_MAGIC, sizeof( PACK_MAGIC ) );
+	hdr.version = PACK_VERSION;
+	hdr.count = files_.size();
+
+	string names;
+	vector<PackEntry> entries( files_.size() );
+	for ( size_t i = 0; i < files_.size(); i++ )
+	{
+		entries[i].hash = packHash( files_[i].name.c_str(), files_[i].name.size() );
+		entries[i].name = names.size();
+		names += files_[i].name;
+		names.push_back( 0 );
+	}
+	hdr.names_size = names.size();
+
+	size_t offset = sizeof( hdr ) + entries.size() * sizeof( PackEntry ) + names.size();
+	for ( size_t i = 0; i < files_.size(); i++ )
+	{
+		offset = ( offset + 7 ) & ~(size_t)7;
+		entries[i].offset = offset;
+		entries[i].size = files_[i].data.size();
+		offset += files_[i].data.size();
+	}
+
+	string tmp( name_ + ".tmp" );
+	FILE *f = fopen( tmp.c_str(), "wb" );
+	if ( !f )
+		return false;
+	bool ok = fwrite( &hdr, sizeof( hdr ), 1, f ) == 1;
+	if ( ok && entries.size() )
+		ok = fwrite( &entries[0], sizeof( PackEntry ), entries.size(), f ) == entries.size();
+	if ( ok )
+		ok = fwrite( names.data(), names.size(), 1, f ) == 1;
+	static const char zeros[8] = { 0 };
+	for ( size_t i = 0; ok && i < files_.size(); i++ )
+	{
+		long pos = ftell( f );
+		if ( pos < (long)entries[i].offset )
+			ok = fwrite( zeros, entries[i].offset - pos, 1, f ) == 1;
+		if ( ok && files_[i].data.size() )
+			ok = fwrite( &files_[i].data[0], files_[i].data.size(), 1, f ) == 1;
+	}
+	ok &= fclose( f ) == 0;
+	remove( name_.c_str() );
+	if ( !ok || rename( tmp.c_str(), name_.c_str() ) )
+	{
+		remove( tmp.c_str() );
+		return false;
+	}
+	return true;
+}
+
+int main( int argc_, const char *argv_[] )
+{
+	string root( "./" );
+	string out;
+	for ( int i = 1; i < argc_; i++ )
+	{
+		string arg( argv_[i] );
+		if ( arg == "-o" && i + 1 < argc_ )
+			out = argv_[++i];
+		else if ( arg[0] == '-' )
+		{
+			printf( "Usage:\n  %s [-o packfile] [resource dir]\n\n"
+			        "Default packfile is '<resource dir>/fltrator.pak'.\n", argv_[0] );
+			return arg == "-h" || arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		else
+		{
+			root = arg;
+			if ( root[ root.size() - 1 ] != '/' )
+				root.push_back( '/' );
+		}
+	}
+	if ( out.empty() )
+		out = root + "fltrator.pak";
+
+	vector<File> files;
+	const char *images[] = { ".gif", ".png", 0 };
+	const char *texts[] = { ".txt", 0 };
+	const char *demos[] = { ".txt", ".dmo", 0 };
+	collect( root, "images/", images, true, 0, files );
+	collect( root, "levels/", texts, true, 0, files );
+	collect( root, "demo/", demos, false, 0, files );
+	collect( root, "", texts, false, "lang_", files );
+
+	if ( files.empty() )
+	{
+		fprintf( stderr, "no resources found in '%s'\n", root.c_str() );
+		return EXIT_FAILURE;
+	}
+	if ( !writePack( out, files ) )
+	{
+		fprintf( stderr, "can't write '%s'\n", out.c_str() );
+		return EXIT_FAILURE;
+	}
+	size_t total = 0;
+	for ( size_t i = 0; i < files.size(); i++ )
+		total += files[i].data.size();
+	printf( "%s: %lu files, %lu bytes\n", out.c_str(),
+	        (unsigned long)files.size(), (unsigned long)total );
+	return EXIT_SUCCESS;
+}
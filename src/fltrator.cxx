@@ -42,9 +42,20 @@
 #include <FL/Fl_Double_Window.H>
 #include <FL/Fl_Shared_Image.H>
 #include <FL/Fl_GIF_Image.H>
+#include <FL/Fl_PNG_Image.H>
 #ifndef NO_PREBUILD_LANDSCAPE
 #include <FL/Fl_Image_Surface.H>
 #endif
+#include <FL/x.H>	// Fl_Offscreen
+#if ( defined(WIN32) || ( defined(FLTK_USES_XRENDER) && !defined(__APPLE__) ) ) && \
+    !defined(FLTK_USE_WAYLAND) && !defined(FLTK_USE_CAIRO)
+// upscale mode: let the GDI/X server scale the offscreen buffer to the window
+// (not with the Wayland/Cairo drivers of FLTK 1.4, their offscreen is no Pixmap)
+#define HAVE_SCALED_BLIT
+#ifndef WIN32
+#include <X11/extensions/Xrender.h>
+#endif
+#endif
 #include <FL/Fl_Preferences.H>
 #include <FL/filename.H>
 #include <FL/fl_draw.H>
@@ -211,6 +222,8 @@ static double _YF = 1.;		// ratio screen ratio/original screen ratio
 static int MAX_SCREEN_W = 1920;
 static int MIN_SCREEN_W = 320;
 static int MAX_SCREEN_H = 1200;
+static int UPSCALE = 0;		// draw at SCREEN_W x SCREEN_H and scale up to window (1=nearest, 2=bilinear)
+static bool STARTUP_TRACE = false;	// print startup timeline at first title frame
 
 #define KEY_LEFT   KEYSET[G_leftHanded].left
 #define KEY_RIGHT  KEYSET[G_leftHanded].right
@@ -225,6 +238,16 @@ using namespace std;
 #include "fl_joystick.cxx"
 #include "resize_image.cxx"
 #include "Fl_Waiter.H"
+#include "image_cache.H"
+#include "pixels.H"
+#include "asset_pack.H"
+#include "startup.H"
+#include "text_cache.H"
+#include "alloc_track.H"
+#include "demo_file.H"
+#include "demo_journal.H"
+#include "snapshot.H"
+#include "autopilot.H"
 
 //-------------------------------------------------------------------------------
 enum ObjectType
@@ -248,9 +271,34 @@ enum ObjectType
 
 static void flt_font( int f_, int s_ ) { fl_font( f_, lround( SCALE_X * s_ ) ); }
 
+static void setupImageCache()
+//-------------------------------------------------------------------------------
+{
+	// scaled images are cached per screen size in '~/.fltrator/cache/WxH/'
+	char home_path[ FL_PATH_MAX ];
+#ifdef WIN32
+	fl_filename_expand( home_path, "$APPDATA/" );
+#else
+	fl_filename_expand( home_path, "$HOME/." );
+#endif
+	ostringstream os;
+	os << home_path << APPLICATION << "/cache/" << SCREEN_W << "x" << SCREEN_H << "/";
+	ImageCache::dir( os.str() );
+	LOG( "image cache: " << ImageCache::dir() );
+}
+
 static bool setupScreenSize( int W_, int H_ )
 //-------------------------------------------------------------------------------
 {
+	if ( UPSCALE )
+	{
+		// draw at a fraction of the requested size, it is scaled up when presented
+		int f = 1;
+		while ( W_ / f > MAX_SCREEN_W || H_ / f > MAX_SCREEN_H )
+			f++;
+		W_ /= f;
+		H_ /= f;
+	}
 	if ( W_ >= MIN_SCREEN_W && W_ <= MAX_SCREEN_W &&
 	     H_ >= W_ / 2 && H_ <= MAX_SCREEN_H && W_ >= H_ )
 	{
@@ -258,6 +306,7 @@ static bool setupScreenSize( int W_, int H_ )
 		SCREEN_H = H_;
 		SCALE_X = (double)SCREEN_W / 800;
 		SCALE_Y = (double)SCREEN_H / 600;
+		setupImageCache();
 		LOG( "SCALE_X: " << SCALE_X );
 		LOG( "SCALE_Y: " << SCALE_Y );
 		return true;
@@ -272,7 +321,8 @@ static bool setupScreenSize( int W_, int H_ )
 			PERR( "" );
 			PERR( "   Using a larger screen size than 1920x1200 requires a" << endl <<
 			      "   really powerful computer and you need to change the" << endl <<
-			      "   allowed sizes in the file 'ini.txt' (in 'levels' dir)" );
+			      "   allowed sizes in the file 'ini.txt' (in 'levels' dir)" << endl <<
+			      "   or use --upscale to draw at a lower resolution." );
 		}
 	}
 	return false;
@@ -396,6 +446,34 @@ static const string& homeDir()
 	return home;
 }
 
+static const AssetPack& assets()
+//-------------------------------------------------------------------------------
+{
+	// Resources are looked up in the pack file 'fltrator.pak' (if present)
+	// first and only then in the file system. So a packed file can't be
+	// replaced by a loose file (the pack must be rebuilt), but files not
+	// in the pack (e.g. new levels) are still found.
+	static AssetPack pack;
+	static bool opened = false;
+	if ( !opened )
+	{
+		opened = true;
+		string name( homeDir() + APPLICATION + ".pak" );
+		if ( pack.open( name, homeDir() ) )
+		{
+			LOG( "using asset pack '" << name << "' (" << pack.size() << " bytes)" );
+			ImageCache::pack( &pack );
+		}
+	}
+	return pack;
+}
+
+static bool fileExists( const string& file_ )
+//-------------------------------------------------------------------------------
+{
+	return assets().contains( file_ ) || access( file_.c_str(), R_OK ) == 0;
+}
+
 static string asString( long n_ )
 //-------------------------------------------------------------------------------
 {
@@ -438,30 +516,59 @@ class LevelPath
 {
 public:
 	LevelPath( const string& baseDir_ ) :
-		_baseDir( baseDir_ ), _level( 0 ) {}
-	string get( const string& file_ ) const
+		_baseDir( baseDir_ ), _level( 0 ), _paths( &_sets[ "0" ] ) {}
+	// NOTE: resolved paths are remembered (per level), so asking
+	//       again for the same file doesn't allocate or access files.
+	//       Remembered paths are never removed, so the returned
+	//       reference stays valid after a level change.
+	const string& get( const char *file_ ) const
+	{
+		_key.assign( file_ );	// reuses capacity
+		map<string, string>::const_iterator it = _paths->find( _key );
+		if ( it != _paths->end() )
+			return it->second;
+		return (*_paths)[ _key ] = resolve( _key );
+	}
+	const string& get( const string& file_ ) const { return get( file_.c_str() ); }
+	void level( size_t level_ )
+	{
+		if ( level_ == _level )
+			return;
+		_level = level_;
+		select();
+	}
+	void ext( const string& ext_ )
+	{
+		_ext = ext_;
+		if ( _ext.size() )
+			_ext.insert( 0, "." );
+		select();
+	}
+private:
+	string resolve( const string& file_ ) const
 	{
 		if ( file_.find( '/' ) != string::npos )	// do not change paths
 			return file_;
 		if ( _level )
 		{
 			string p = mkPath( _baseDir, asString( _level ), file_ + _ext );
-			if ( access( p.c_str(), R_OK ) == 0 )
+			if ( fileExists( p ) )
 				return p;
 		}
 		return mkPath( _baseDir, "", file_ + _ext );
 	}
-	void level( size_t level_ ) { _level = level_; }
-	void ext( const string& ext_ )
+	void select()
 	{
-		_ext = ext_;
-		if ( _ext.size() )
-			_ext.insert( 0, "." );
+		// one set of paths per level and extension
+		_paths = &_sets[ asString( _level ) + _ext ];
 	}
 private:
 	string _baseDir;
 	size_t _level;
 	string _ext;
+	map<string, map<string, string> > _sets;
+	map<string, string> *_paths;	// set of current level
+	mutable string _key;
 };
 
 static string levelPath( const string& file_ = "" )
@@ -476,6 +583,14 @@ static string demoPath( const string& file_ = "" )
 	return mkPath( "demo", "", file_ );
 }
 
+static DemoJournal& demoJournal()
+//-------------------------------------------------------------------------------
+{
+	// static: pending demo files are written on exit()
+	static DemoJournal journal;
+	return journal;
+}
+
 static LevelPath wavPath( "wav" );
 static LevelPath imgPath( "images" );
 
@@ -842,10 +957,11 @@ public:
 private:
 	Audio();
 	~Audio();
-	bool allowed( const string& f_ ) const;
+	bool allowed( const char *f_ ) const;
 	void stop( const string& pidfile_ );
 	bool kill_sound( const string& pidfile_ );
 	static bool terminate_player( pid_t pid_, const string& pidfile_ );
+	static int run( const string& cmd_ );
 	string _playCmd;
 	string _bgPlayCmd;
 	string _ext;
@@ -857,6 +973,7 @@ private:
 	string _bgsound;
 	bool _repeat;
 	bool _no_explosions;
+	map<string, string> _cmdCache;	// wav path => play command
 };
 
 //-------------------------------------------------------------------------------
@@ -902,12 +1019,8 @@ Audio::Audio() :
 //-------------------------------------------------------------------------------
 {
 	cmd( string() );
-	// aplay might still be running from a previous invocation,
-	// so look for the first non existing pidfile.
-	// (Should we use mkstemp() to create a filename?)
-	int id( _id );
-	while ( !access( bgPidFileName( ++id ).c_str(), R_OK ) ) ;
-	_id = --id;
+	// NOTE: pidfile id is determined on first bg sound (see play())
+	_id = -1;
 }
 
 Audio::~Audio()
@@ -1036,6 +1149,7 @@ void Audio::cmd( const string& cmd_ )
 	_playCmd = playCmd.empty() ? DefaultCmd : playCmd;
 	_bgPlayCmd = bgPlayCmd.empty() ? DefaultBgCmd : bgPlayCmd;
 	_ext = ext.empty() ? "wav" : ext;
+	_cmdCache.clear();
 }
 
 /*static*/
@@ -1053,10 +1167,10 @@ Audio *Audio::instance( bool create_/* = true*/)
 	return inst;
 }
 
-bool Audio::allowed( const string& f_ ) const
+bool Audio::allowed( const char *f_ ) const
 //-------------------------------------------------------------------------------
 {
-	if ( _no_explosions && f_.find( "x_" ) == 0 )
+	if ( _no_explosions && strncmp( f_, "x_", 2 ) == 0 )
 		return false;
 	return true;
 }
@@ -1068,6 +1182,14 @@ bool Audio::play( const char *file_, bool bg_/* = false*/, bool repeat_/* = true
 	bool disabled( ( bg_ && _bg_disabled ) || ( !bg_ && _disabled ) );
 	if ( !disabled && file_ && allowed( file_ ) )
 	{
+		const string& path = wavPath.get( file_ );
+		if ( !bg_ )
+		{
+			// command for a sound effect is built only once
+			map<string, string>::const_iterator it = _cmdCache.find( path );
+			if ( it != _cmdCache.end() )
+				return !run( it->second );
+		}
 		string file( file_ );
 		string cmd( bg_ ? _bgPlayCmd : _playCmd );
 		bool runInBg( false );
@@ -1075,6 +1197,15 @@ bool Audio::play( const char *file_, bool bg_/* = false*/, bool repeat_/* = true
 		if ( bg_ )
 		{
 			stop_bg();
+			if ( _id < 0 )
+			{
+				// aplay might still be running from a previous invocation,
+				// so look for the first non existing pidfile.
+				// (Should we use mkstemp() to create a filename?)
+				int id( 0 );
+				while ( !access( bgPidFileName( ++id ).c_str(), R_OK ) ) ;
+				_id = --id;
+			}
 			_bgpidfile = bgPidFileName( ++_id );
 			_bgsound = file;
 			_repeat = repeat_;
@@ -1086,11 +1217,11 @@ bool Audio::play( const char *file_, bool bg_/* = false*/, bool repeat_/* = true
 		else
 			pos = cmd.find( "%F" );
 		if ( pos == string::npos )
-			cmd += ( ' ' + quote( wavPath.get( file ) ) );
+			cmd += ( ' ' + quote( path ) );
 		else
 		{
 			cmd.erase( pos, 2 );
-			cmd.insert( pos, quote( wavPath.get( file ) ) );
+			cmd.insert( pos, quote( path ) );
 		}
 		if ( bg_ )
 		{
@@ -1108,38 +1239,49 @@ bool Audio::play( const char *file_, bool bg_/* = false*/, bool repeat_/* = true
 		}
 		if ( runInBg )
 			cmd += " &";
+		if ( !bg_ )
+			_cmdCache[ path ] = cmd;
 
-		// execute command 'cmd'
+		ret = run( cmd );
+	}
+	return !disabled && !ret;
+}
+
+/*static*/
+int Audio::run( const string& cmd_ )
+//-------------------------------------------------------------------------------
+{
+	// execute command 'cmd_'
+	int ret = 0;
 #ifdef WIN32
-		static STARTUPINFO si = { 0 };
-		static DWORD dwCreationFlags = CREATE_NO_WINDOW | CREATE_NEW_PROCESS_GROUP | DETACHED_PROCESS;
-		if ( !si.cb )
-		{
-			si.cb = sizeof(si);
-			si.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW | STARTF_FORCEOFFFEEDBACK;
-			si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
-			si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
-			si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
-			si.wShowWindow = SW_HIDE;
+	static STARTUPINFO si = { 0 };
+	static DWORD dwCreationFlags = CREATE_NO_WINDOW | CREATE_NEW_PROCESS_GROUP | DETACHED_PROCESS;
+	if ( !si.cb )
+	{
+		si.cb = sizeof(si);
+		si.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW | STARTF_FORCEOFFFEEDBACK;
+		si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+		si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+		si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+		si.wShowWindow = SW_HIDE;
 
-			if ( !getenv( "PLAYSOUND_STANDARD_PRIORITY" ) )
-				dwCreationFlags |= ABOVE_NORMAL_PRIORITY_CLASS;
-		}
-		PROCESS_INFORMATION pi = { 0 };
-		if ( ( ret = !CreateProcess(NULL, (LPSTR)cmd.c_str(), NULL, NULL, FALSE,
-		                            dwCreationFlags, NULL, NULL, &si, &pi) ) == 0 )
-		{
-			CloseHandle(pi.hProcess);
-			CloseHandle(pi.hThread);
-		}
+		if ( !getenv( "PLAYSOUND_STANDARD_PRIORITY" ) )
+			dwCreationFlags |= ABOVE_NORMAL_PRIORITY_CLASS;
+	}
+	PROCESS_INFORMATION pi = { 0 };
+	if ( ( ret = !CreateProcess(NULL, (LPSTR)cmd_.c_str(), NULL, NULL, FALSE,
+	                            dwCreationFlags, NULL, NULL, &si, &pi) ) == 0 )
+	{
+		CloseHandle(pi.hProcess);
+		CloseHandle(pi.hThread);
+	}
 #elif __APPLE__
-		ret = system( cmd.c_str() );
+	ret = system( cmd_.c_str() );
 #else
-		// linux
-		ret = system( cmd.c_str() );
+	// linux
+	ret = system( cmd_.c_str() );
 #endif
-	}
-	return !disabled && !ret;
+	return ret;
 }
 
 /*static*/
@@ -1267,6 +1409,113 @@ static void clipImage( int& x_, int& y_, int& w_, int &h_, int& ox_, int& oy_,
 #endif
 #endif
 
+// Sprites used in every level (may be overridden per level)
+static const char *SPRITES[] = {
+	"rocket.gif", "rocket_launched.gif", "radar.gif", "drop.gif",
+	"bady.gif", "bady_hit.gif", "cumulus.gif", "bomb.gif",
+	"phaser.gif", "phaser_active.gif",
+	"lifes1.gif", "lifes2.gif", "lifes3.gif"
+};
+
+//-------------------------------------------------------------------------------
+class DecodedImage : public Fl_Shared_Image
+//-------------------------------------------------------------------------------
+{
+	// Shared image for an image decoded by ourself (from asset pack memory
+	// or by a startup task). It is registered in the shared image list like
+	// a file image, so subsequent calls of Fl_Shared_Image::get() (e.g. for
+	// scaled copies) find it by name.
+public:
+	static Fl_Shared_Image *adopt( const char *name_, Fl_Image *image_ )
+	{
+		return new DecodedImage( name_, image_ );
+	}
+private:
+	DecodedImage( const char *name_, Fl_Image *image_ ) :
+		Fl_Shared_Image( name_, image_ )
+	{
+		original_ = 1;
+		alloc_image_ = 1;
+		add();
+	}
+};
+
+static Fl_Image *decodeImage( const string& name_ )
+//-------------------------------------------------------------------------------
+{
+	// NOTE: called from startup tasks - only decode, no FLTK global state!
+	Fl_Image *image = 0;
+#if FLTK_HAS_IMAGE_SCALING
+	size_t size;
+	const uchar *data = (const uchar *)assets().find( name_, size );
+	if ( data )
+	{
+		if ( size >= 6 && memcmp( data, "GIF8", 4 ) == 0 )
+			image = new Fl_GIF_Image( name_.c_str(), data, size );
+		else if ( size >= 8 && memcmp( data, "\x89PNG", 4 ) == 0 )
+			image = new Fl_PNG_Image( name_.c_str(), data, (int)size );
+		else
+			return 0;
+	}
+	else
+#endif
+	if ( fl_filename_match( name_.c_str(), "*.gif" ) )
+		image = new Fl_GIF_Image( name_.c_str() );
+	if ( image && image->fail() )
+	{
+		delete image;
+		image = 0;
+	}
+	return image;
+}
+
+struct PreloadedImage
+{
+	string name;
+	Fl_Image *image;
+};
+static map<string, PreloadedImage *> preloadedImages;
+
+static void decodeImageTask( void *arg_ )
+//-------------------------------------------------------------------------------
+{
+	PreloadedImage *p = (PreloadedImage *)arg_;
+	p->image = decodeImage( p->name );
+}
+
+static void preloadImage( const string& name_ )
+//-------------------------------------------------------------------------------
+{
+	if ( preloadedImages.find( name_ ) != preloadedImages.end() )
+		return;
+	PreloadedImage *p = new PreloadedImage;
+	p->name = name_;
+	p->image = 0;
+	preloadedImages[ name_ ] = p;
+	Startup::run( p->name.c_str(), decodeImageTask, p );
+}
+
+static Fl_Shared_Image *getSharedImage( const char *name_ )
+//-------------------------------------------------------------------------------
+{
+	Fl_Shared_Image *image = Fl_Shared_Image::find( name_ );
+	if ( image )
+		return image;
+	Fl_Image *decoded = 0;
+	map<string, PreloadedImage *>::iterator it = preloadedImages.find( name_ );
+	if ( it != preloadedImages.end() )
+	{
+		Startup::wait( name_ );
+		decoded = it->second->image;
+		it->second->image = 0;
+	}
+	else if ( assets().contains( name_ ) )
+		decoded = decodeImage( name_ );
+	if ( decoded )
+		return DecodedImage::adopt( name_, decoded );
+	return Fl_Shared_Image::get( name_ );
+}
+
 //-------------------------------------------------------------------------------
 class FltImage
 //-------------------------------------------------------------------------------
@@ -1276,7 +1525,9 @@ public:
 	{
 		ImageInfo() : valid( false ), image( 0 ), imageForDrawing( 0 ),
 		              orig_image( 0 ), origImageForDrawing( 0 ),
-		              frames( 0 ), timeout( 0. ) {}
+		              frames( 0 ), timeout( 0. ), atlas_x( -1 ), atlas_y( -1 ),
+		              w( 0 ), h( 0 ), orig_w( 0 ), orig_h( 0 ), mask( 0 ),
+		              cached( 0 ) {}
 		bool valid;
 		Fl_Shared_Image *image;
 		Fl_RGB_Image *imageForDrawing;
@@ -1284,15 +1535,28 @@ public:
 		Fl_RGB_Image *origImageForDrawing;
 		int frames;
 		double timeout;
+		int atlas_x;	// position of frame strip in sprite atlas (-1 = not in atlas)
+		int atlas_y;
+		int w;	// size of (scaled) frame strip
+		int h;
+		int orig_w;	// size of original frame strip
+		int orig_h;
+		const uchar *mask;	// opacity of strip pixels (w * h)
+		const uchar *cached;	// pixels mapped from disk cache (image not decoded)
 	};
 
 	FltImage() :
+		_info( 0 ),
+		_key( 0 ),
+		_gen( 0 ),
 		_image( 0 ),
 		_imageForDrawing( 0 ),
 		_orig_image( 0 ),
 		_origImageForDrawing( 0 ),
+		_mask( 0 ),
 		_animate_timeout( 0. ),
 		_frames( 0 ),
+		_strip_w( 0 ),
 		_ox( 0 ),
 		_w( 0 ),
 		_h( 0 ),
@@ -1310,7 +1574,7 @@ public:
 	void nextFrame()
 	{
 		_ox += _w;
-		if ( _ox >= _image->w() )
+		if ( _ox >= _strip_w )
 			_ox = 0;
 	}
 	void draw( int x_, int y_ )
@@ -1327,6 +1591,12 @@ public:
 		clipImage( X, Y, W, H, ox, oy, SCREEN_W, SCREEN_H );
 		drawImage()->draw( X, Y, W, H, _ox + ox, oy );
 #else	// !defined(WIN32) && !defined(FLTK_USES_XRENDER)
+		if ( _atlas && _info && _gen == _generation && _info->atlas_x >= 0 )
+		{
+			// blit current frame directly from the sprite atlas
+			_atlas->draw( x_, y_, _w, _h, _info->atlas_x + _ox, _info->atlas_y );
+			return;
+		}
 		fl_push_clip( x_, y_, _w, _h );
 		drawImage()->draw( x_ - _ox, y_ );
 		fl_pop_clip();
@@ -1334,71 +1604,57 @@ public:
 	}
 	bool get( const char *image_, double scale_ = 1. )
 	{
-		ImageInfo ii = _icache[ image_ ];
+		if ( _info && _info->valid && _gen == _generation && *_key == image_ )
+			return false;	// same image (the usual case for every frame)
+		static string key;
+		key.assign( image_ );	// reuses capacity
+		map<string, ImageInfo>::iterator it = _icache.find( key );
+		ImageInfo ii = it != _icache.end() ? it->second : ImageInfo();
 		bool image_path_changed( false );
 		if ( !ii.valid ) // image not yet cached?
 		{
-			// load image once and cache it
-			Fl_Shared_Image *image = Fl_Shared_Image::get( image_ );
-			if ( image && image->count() )
+			// Try to use scaled image + mask from disk cache first,
+			// so the image doesn't need to be decoded and scaled.
+			bool known = readImageInfo( image_, ii );
+			int w = 0;
+			int h = 0;
+			const uchar *pixels = 0;
+			if ( known )
+				scaledSize( ii, scale_, w, h );
+#if FLTK_HAS_NEW_FUNCTIONS
+			if ( w > 0 && h > 0 )
 			{
-				// check for "animated" image
-				ii.frames = 1;
-				const char *p = strstr( image_, "_" );
-				if ( p && isdigit( p[1] ) )
+				int d = 0;
+				const uchar *mask = 0;
+				pixels = ImageCache::load( image_, cacheTag( ii ).c_str(), w * ii.frames, h, d, &mask );
+				if ( pixels )
 				{
-					// extract frames/delay from image name 'name_<frames>_<delay>.gif' ...
-					p++;
-					ii.frames = atoi( p );
-					p = strstr( p, "_" );
-					if ( p )
-					{
-						p++;
-						ii.timeout = (double)atoi( p ) / 1000;
-					}
-				}
-				else
-				{
-					// Try to read gif comment field for keywords 'frames', 'delay'.
-					// NOTE: for now just search in the first 1024 bytes of the file...
-					ifstream ifs( image_, ios::binary );
-					char buf[1024];
-					memset( buf, 0, sizeof( buf ) );
-					ifs.read( buf, sizeof( buf ) );
-					string s( buf, sizeof( buf ) );
-					size_t pos = s.find( "frames=" );
-					if ( pos != string::npos )
-						ii.frames = atoi( &s.c_str()[pos + 7] );
-					if ( ii.frames > 1 )
-					{
-						/*size_t*/ pos = s.find( "delay=" );
-						if ( pos != string::npos )
-							ii.timeout = (double)atoi( &s.c_str()[pos + 6] ) / 1000;
-					}
+					ii.imageForDrawing = new Fl_RGB_Image( pixels, w * ii.frames, h, d );
+					ii.w = w * ii.frames;
+					ii.h = h;
+					ii.mask = mask;
+					ii.cached = pixels;
+					ii.valid = true;
+					LOG( "image '" << image_ << "' " << ii.w << "x" << ii.h << " loaded from disk cache" );
 				}
-				if ( ii.frames < 0 )
-					ii.frames = 1;
-				if ( ii.timeout && ii.timeout < 0.05 )
-					ii.timeout = 0.05;
-
+			}
+#endif
+			// load image once and cache it
+			Fl_Shared_Image *image = pixels ? 0 : getSharedImage( image_ );
+			if ( image && image->count() )
+			{
 				// Correct scaling for animated images
 #if FLTK_HAS_NEW_FUNCTIONS
 				Fl_Image::RGB_scaling( FL_RGB_SCALING_BILINEAR );
+
+				// the size in the image header is the size of the first frame
+				// (usually the whole image), don't cache if it differs
+				bool cacheable = w > 0 && h > 0 && image->w() == ii.orig_w && image->h() == ii.orig_h;
 #endif
-				ii.orig_image = image;
-				ii.origImageForDrawing = 0;
-				int w = image->w();
-				int h = image->h();
-				if ( ii.frames > 0 )
-				{
-					w /= ii.frames;
-					_orig_w = w;
-					w = lround( SCALE_X * w );
-				}
-				else
-					w = lround( SCALE_X * w );
-				w *= scale_;
-				h = lround( SCALE_Y * h * scale_ );
+				ii.orig_w = image->w();
+				ii.orig_h = image->h();
+				scaledSize( ii, scale_, w, h );
+				loadOrig( ii, image_ );
 
 				// Scale pixmap image
 				image = Fl_Shared_Image::get( image_, w * ii.frames, h );
@@ -1409,28 +1665,30 @@ public:
 //				if ( _image )
 //					_image->release();
 				ii.image = image;
+				ii.w = image->w();
+				ii.h = image->h();
+				ii.mask = makeMask( image );
 				LOG( "image '" << image_ << "' " << image->w() << "x" << image->h() << " cached" );
 #if FLTK_HAS_NEW_FUNCTIONS
-				Fl_Image *rgb = ii.orig_image;
-				if ( ii.orig_image->count() > 2 )
-				{
-					// NOTE: Pixmap images used for drawing will only
-					//       be converted once from Pixmap to RGB.
-					rgb = new Fl_RGB_Image( (Fl_Pixmap *)ii.orig_image );
-					assert( rgb );
-					ii.origImageForDrawing = (Fl_RGB_Image *)rgb;
-				}
+				Fl_Image *rgb = ii.origImageForDrawing ? (Fl_Image *)ii.origImageForDrawing : (Fl_Image *)ii.orig_image;
 				ii.imageForDrawing = (Fl_RGB_Image *)fl_copy_image( rgb, image->w(), image->h() );
+				if ( ii.imageForDrawing && cacheable )
+					ImageCache::save( image_, cacheTag( ii ).c_str(), *ii.imageForDrawing, ii.mask );
 #endif
 
 				// save image information to cache
 				ii.valid = true;
-				_icache[ image_ ] = ii;
 			}
 		}
-		string last_name = name();
+		if ( it == _icache.end() )
+			it = _icache.insert( make_pair( key, ii ) ).first;
+		else
+			it->second = ii;
+		image_path_changed = _gen != _generation || _key != &it->first;
+		_key = &it->first;
+		_gen = _generation;
+		_info = &it->second;
 		_image = ii.image;
-		image_path_changed = name() != last_name;
 		if ( image_path_changed )	// don't reset offset if same image was requested
 			_ox = 0;
 		_animate_timeout = ii.timeout;
@@ -1438,12 +1696,14 @@ public:
 		_imageForDrawing = ii.imageForDrawing;
 		_orig_image = ii.orig_image;
 		_origImageForDrawing = ii.origImageForDrawing;
-		_h = _image ? _image->h() : 0;
-		_w = _image ? _image->w() : 0;
+		_mask = ii.mask;
+		_h = ii.h;
+		_w = ii.w;
+		_strip_w = ii.w;
 		if ( _frames > 1 )
 			_w /= _frames;
-		_orig_h = _orig_image ? _orig_image->h() : 0;
-		_orig_w = _orig_image ? _orig_image->w() : 0;
+		_orig_h = ii.orig_h;
+		_orig_w = ii.orig_w;
 		if ( _frames > 1 )
 			_orig_w /= _frames;
 
@@ -1451,13 +1711,27 @@ public:
 	}
 	bool isTransparent( size_t x_, size_t y_ ) const
 	{
-		// valid only for pixmaps!
 		x_ += _ox; // for animated images use the current frame
+		if ( _mask )
+		{
+			assert( (int)x_ < _strip_w && (int)y_ < _h );
+			return !_mask[ y_ * _strip_w + x_ ];
+		}
+		if ( _image && _image->count() > 2 )
+		{
+			// pixmap data
 #if FLTK_HAS_IMAGE_SCALING
-		assert( _image->w() == _image->data_w() && _image->h() == _image->data_h() );
+			assert( _image->w() == _image->data_w() && _image->h() == _image->data_h() );
 #endif
-		assert( (int)x_ < _image->w() && (int)y_ < _image->h() );
-		return _image->data()[y_ + 2][x_] == ' ';
+			assert( (int)x_ < _image->w() && (int)y_ < _image->h() );
+			return _image->data()[y_ + 2][x_] == ' ';
+		}
+		// RGB(A) image (e.g. from disk cache)
+		const Fl_Image *rgb = drawImage();
+		if ( !rgb || rgb->d() != 4 || rgb->count() != 1 )
+			return false;
+		int ld = rgb->ld() ? rgb->ld() : rgb->w() * 4;
+		return !( (const uchar *)rgb->data()[0] )[ y_ * ld + x_ * 4 + 3 ];
 	}
 	double animate_timeout() const { return _animate_timeout; }
 	Fl_Image *drawImage() const
@@ -1467,21 +1741,164 @@ public:
 	Fl_Image *image() const { return (Fl_Image *)_image; }
 	Fl_Image *origDrawImage() const
 	{
+		if ( !_orig_image && _key && _gen == _generation )
+		{
+			// image from disk cache: decode original only when needed
+			ImageInfo& ii = _icache[ *_key ];
+			loadOrig( ii, *_key );
+			_orig_image = ii.orig_image;
+			_origImageForDrawing = ii.origImageForDrawing;
+		}
 		return _origImageForDrawing ? (Fl_Image *)_origImageForDrawing : (Fl_Image *)_orig_image;
 	}
-	string name() const { return _image ? _image->name() : ""; }
+	string name() const { return _key && _gen == _generation ? *_key : ""; }
 	int w() const { return _w; }
 	int h() const { return _h; }
 	int orig_w() const { return _orig_w; }
 	int orig_h() const { return _orig_h; }
-	static void uncache() { _icache.clear(); }
+	static void uncache()
+	{
+		delete _atlas;
+		_atlas = 0;
+		_atlasId.erase();
+		for ( map<string, ImageInfo>::iterator it = _icache.begin(); it != _icache.end(); ++it )
+		{
+			// release images mapped from disk cache
+			if ( it->second.cached )
+			{
+				delete it->second.imageForDrawing;
+				ImageCache::release( it->second.cached );
+			}
+		}
+		_icache.clear();
+		_generation++;	// invalidates all _info/_key pointers
+	}
+	// is atlas 'id_' built (or tried to)?
+	static bool hasAtlas( const string& id_ ) { return !_atlasId.empty() && _atlasId == id_; }
+	static bool buildAtlas( const vector<string>& images_, const string& id_ );
 private:
+	static bool readImageInfo( const char *image_, ImageInfo& ii_ )
+	{
+		// Get frames/delay and the size of the image from its name and
+		// header (without decoding it). Returns false if size is unknown.
+		ii_.frames = 1;
+		AssetStream ifs( assets(), image_, ios::binary );
+		char buf[1024];
+		memset( buf, 0, sizeof( buf ) );
+		ifs.read( buf, sizeof( buf ) );
+		const char *p = strstr( image_, "_" );
+		if ( p && isdigit( p[1] ) )
+		{
+			// extract frames/delay from image name 'name_<frames>_<delay>.gif' ...
+			p++;
+			ii_.frames = atoi( p );
+			p = strstr( p, "_" );
+			if ( p )
+			{
+				p++;
+				ii_.timeout = (double)atoi( p ) / 1000;
+			}
+		}
+		else
+		{
+			// Try to read gif comment field for keywords 'frames', 'delay'.
+			// NOTE: for now just search in the first 1024 bytes of the file...
+			string s( buf, sizeof( buf ) );
+			size_t pos = s.find( "frames=" );
+			if ( pos != string::npos )
+				ii_.frames = atoi( &s.c_str()[pos + 7] );
+			if ( ii_.frames > 1 )
+			{
+				/*size_t*/ pos = s.find( "delay=" );
+				if ( pos != string::npos )
+					ii_.timeout = (double)atoi( &s.c_str()[pos + 6] ) / 1000;
+			}
+		}
+		if ( ii_.frames < 0 )
+			ii_.frames = 1;
+		if ( ii_.timeout && ii_.timeout < 0.05 )
+			ii_.timeout = 0.05;
+
+		const uchar *b = (const uchar *)buf;
+		if ( memcmp( b, "GIF8", 4 ) == 0 )
+		{
+			ii_.orig_w = b[6] | b[7] << 8;
+			ii_.orig_h = b[8] | b[9] << 8;
+		}
+		else if ( memcmp( b, "\x89PNG", 4 ) == 0 && memcmp( b + 12, "IHDR", 4 ) == 0 )
+		{
+			ii_.orig_w = b[16] << 24 | b[17] << 16 | b[18] << 8 | b[19];
+			ii_.orig_h = b[20] << 24 | b[21] << 16 | b[22] << 8 | b[23];
+		}
+		else
+			return false;
+		return ii_.orig_w > 0 && ii_.orig_h > 0;
+	}
+	static void scaledSize( const ImageInfo& ii_, double scale_, int& w_, int& h_ )
+	{
+		// size of one scaled frame
+		int w = ii_.orig_w;
+		if ( ii_.frames > 0 )
+			w /= ii_.frames;
+		w_ = lround( SCALE_X * w );
+		w_ *= scale_;
+		h_ = lround( SCALE_Y * ii_.orig_h * scale_ );
+	}
+	static string cacheTag( const ImageInfo& ii_ )
+	{
+		ostringstream os;
+		os << "sprite" << ii_.frames;
+		return os.str();
+	}
+	static void loadOrig( ImageInfo& ii_, const string& name_ )
+	{
+		// original (unscaled) image, pixmaps converted once to RGB
+		if ( ii_.orig_image )
+			return;
+		ii_.orig_image = getSharedImage( name_.c_str() );
+		ii_.origImageForDrawing = 0;
+#if FLTK_HAS_NEW_FUNCTIONS
+		if ( ii_.orig_image && ii_.orig_image->count() > 2 )
+			ii_.origImageForDrawing = new Fl_RGB_Image( (Fl_Pixmap *)ii_.orig_image );
+#endif
+	}
+	static const uchar *makeMask( const Fl_Image *image_ )
+	{
+		// opacity mask from pixmap data (' ' = transparent)
+		if ( image_->count() < 3 )
+			return 0;
+		int W = image_->w();
+		int H = image_->h();
+#if FLTK_HAS_IMAGE_SCALING
+		if ( W != image_->data_w() || H != image_->data_h() )
+			return 0;
+#endif
+		uchar *mask = new uchar[ W * H ];
+		for ( int y = 0; y < H; y++ )
+		{
+			const char *row = image_->data()[ y + 2 ];
+			for ( int x = 0; x < W; x++ )
+				mask[ y * W + x ] = row[x] != ' ';
+		}
+		return mask;
+	}
+private:
+	static bool byHeight( const ImageInfo *a_, const ImageInfo *b_ )
+	{
+		return a_->imageForDrawing->h() > b_->imageForDrawing->h();
+	}
+private:
+	const ImageInfo *_info;
+	const string *_key;	// key of _info in _icache
+	unsigned _gen;	// _generation of _key/_info
 	Fl_Shared_Image *_image;
 	Fl_RGB_Image *_imageForDrawing;
-	Fl_Shared_Image *_orig_image;
-	Fl_RGB_Image *_origImageForDrawing;
+	mutable Fl_Shared_Image *_orig_image;	// (decoded on demand)
+	mutable Fl_RGB_Image *_origImageForDrawing;
+	const uchar *_mask;
 	double _animate_timeout;
 	int _frames;
+	int _strip_w;
 	int _ox;
 	int _w;
 	int _h;
@@ -1489,10 +1906,113 @@ private:
 	int _orig_h;
 protected:
 	static map<string, ImageInfo> _icache;
+	static unsigned _generation;
+	static Fl_RGB_Image *_atlas;
+	static string _atlasId;	// images of _atlas
 };
 
 /*static*/
 map<string, FltImage::ImageInfo> FltImage::_icache;
+/*static*/
+unsigned FltImage::_generation = 1;
+/*static*/
+Fl_RGB_Image *FltImage::_atlas = 0;
+/*static*/
+string FltImage::_atlasId;
+
+/*static*/
+bool FltImage::buildAtlas( const vector<string>& images_, const string& id_ )
+//-------------------------------------------------------------------------------
+{
+	// Pack the (already scaled) RGB draw images of all given sprites
+	// into one RGBA image, so they can be drawn as sub-rects of a
+	// single image (= one pixmap/texture) instead of clipping strips.
+	delete _atlas;
+	_atlas = 0;
+	_atlasId = id_;
+	for ( map<string, ImageInfo>::iterator it = _icache.begin(); it != _icache.end(); ++it )
+	{
+		it->second.atlas_x = -1;
+		it->second.atlas_y = -1;
+	}
+#if (FLTK_HAS_NEW_FUNCTIONS) && ( defined(WIN32) || defined(FLTK_USES_XRENDER) )
+	vector<ImageInfo *> sprites;
+	int W = 1024;
+	for ( size_t i = 0; i < images_.size(); i++ )
+	{
+		FltImage image;
+		image.get( images_[i].c_str() );	// load if not yet cached
+		ImageInfo& ii = _icache[ images_[i] ];
+		if ( !ii.valid || !ii.imageForDrawing || ii.atlas_x == 0 )
+			continue;
+		Fl_RGB_Image *rgb = ii.imageForDrawing;
+#if FLTK_HAS_IMAGE_SCALING
+		if ( rgb->data_w() != rgb->w() || rgb->data_h() != rgb->h() )
+			continue;
+#endif
+		if ( rgb->d() != 3 && rgb->d() != 4 )
+			continue;
+		ii.atlas_x = 0;	// mark as taken (also for duplicates in list)
+		sprites.push_back( &ii );
+		W = max( W, rgb->w() );
+	}
+	if ( sprites.empty() )
+		return false;
+
+	// simple shelf packing with sprites sorted by height
+	stable_sort( sprites.begin(), sprites.end(), byHeight );
+	int x = 0;
+	int y = 0;
+	int shelf_h = 0;
+	for ( size_t i = 0; i < sprites.size(); i++ )
+	{
+		const Fl_RGB_Image *rgb = sprites[i]->imageForDrawing;
+		if ( x + rgb->w() > W )
+		{
+			x = 0;
+			y += shelf_h;
+			shelf_h = 0;
+		}
+		sprites[i]->atlas_x = x;
+		sprites[i]->atlas_y = y;
+		x += rgb->w();
+		shelf_h = max( shelf_h, rgb->h() );
+	}
+	int H = y + shelf_h;
+
+	uchar *buf = new uchar[ W * H * 4 ];
+	memset( buf, 0, W * H * 4 );
+	for ( size_t i = 0; i < sprites.size(); i++ )
+	{
+		const Fl_RGB_Image *rgb = sprites[i]->imageForDrawing;
+		int d = rgb->d();
+		int ld = rgb->ld() ? rgb->ld() : rgb->w() * d;
+		for ( int r = 0; r < rgb->h(); r++ )
+		{
+			const uchar *src = (const uchar *)rgb->array + r * ld;
+			uchar *dst = buf + ( ( sprites[i]->atlas_y + r ) * W + sprites[i]->atlas_x ) * 4;
+			if ( d == 4 )
+			{
+				memcpy( dst, src, rgb->w() * 4 );
+				continue;
+			}
+			for ( int c = 0; c < rgb->w(); c++ )
+			{
+				*dst++ = *src++;
+				*dst++ = *src++;
+				*dst++ = *src++;
+				*dst++ = 0xff;
+			}
+		}
+	}
+	_atlas = new Fl_RGB_Image( buf, W, H, 4 );
+	_atlas->alloc_array = 1;
+	LOG( "sprite atlas " << W << "x" << H << " with " << sprites.size() << " images" );
+	return true;
+#else
+	return false;
+#endif
+}
 
 //-------------------------------------------------------------------------------
 class Object
@@ -1558,6 +2078,8 @@ public:
 	double animate_timeout() const { return _image.animate_timeout(); }
 	void dxRange( int dxRange_ ) { _dxRange = dxRange_; }
 	int dxRange() const { return _dxRange; }
+	virtual void save( Snapshot& s_ ) const;
+	virtual void restore( Snapshot& s_ );
 private:
 	void _explode( double to_ = 0. );
 	virtual bool onHit() { return false; }
@@ -1713,14 +2235,21 @@ void Object::draw_collision() const
 	int sz = ( w() > h() ? w() : h() ) / 10;
 	++sz &= ~1;
 	int pts = w() * h() / sz / sz * 20;
+	static vector<uint32_t> rnd;
+	rnd.resize( pts * 3 );
+	if ( rnd.empty() )
+		return;
+	Random::Xoshiro128& rng = Random::Cosmetic();
+	rng.fill( &rnd[0], rnd.size() );
 	for ( int i = 0; i < pts; i++ )
 	{
-		unsigned X = Random::pRand() % w();
-		unsigned Y = Random::pRand() % h();
+		const uint32_t *r = &rnd[ i * 3 ];
+		unsigned X = ( (uint64_t)r[0] * w() ) >> 32;
+		unsigned Y = ( (uint64_t)r[1] * h() ) >> 32;
 		if ( !isTransparent( X, Y ) )
 		{
 			fl_rectf( x() + X - sz / 2, y() + Y - sz / 2, sz, sz,
-			          ( Random::pRand() % 2 ? ( Random::pRand() % 2 ? 0xff660000 : FL_RED ) : FL_YELLOW ) );
+			          ( r[2] & 1 ? ( r[2] & 2 ? 0xff660000 : FL_RED ) : FL_YELLOW ) );
 		}
 	}
 }
@@ -1789,6 +2318,38 @@ void Object::_explode( double to_ )
 	}
 }
 
+/*virtual*/
+void Object::save( Snapshot& s_ ) const
+//-------------------------------------------------------------------------------
+{
+	s_ << _image.name() << _x << _y << _w << _h << _X << _Y << _speed
+	   << _dxRange << _state << _data1 << _data2 << _nostart << _exploding
+	   << _exploded << _hit << _timeout << _hits;
+}
+
+/*virtual*/
+void Object::restore( Snapshot& s_ )
+//-------------------------------------------------------------------------------
+{
+	string name;
+	s_ >> name;
+	if ( name.size() && name != _image.name() )
+		image( name.c_str() );
+	s_ >> _x >> _y >> _w >> _h >> _X >> _Y >> _speed
+	   >> _dxRange >> _state >> _data1 >> _data2 >> _nostart >> _exploding
+	   >> _exploded >> _hit >> _timeout >> _hits;
+
+	// timers run, as they would in the saved state
+	Fl::remove_timeout( cb_update, this );
+	Fl::remove_timeout( cb_explosion_end, this );
+	if ( started() )
+		Fl::add_timeout( timeout(), cb_update, this );
+	if ( _exploding && !_exploded )
+		Fl::add_timeout( 0.05, cb_explosion_end, this );
+	else if ( _hit )
+		Fl::add_timeout( 0.02, cb_explosion_end, this );
+}
+
 //-------------------------------------------------------------------------------
 class Rocket : public Object
 //-------------------------------------------------------------------------------
@@ -1835,6 +2396,12 @@ public:
 			stop_animate();
 		return hits() > 2;
 	}
+	virtual void restore( Snapshot& s_ )
+	{
+		Inherited::restore( s_ );
+		if ( hits() )
+			stop_animate();
+	}
 };
 
 //-------------------------------------------------------------------------------
@@ -1865,6 +2432,16 @@ public:
 		_x += ceil( SCALE_X * _dx );
 		Inherited::update();
 	}
+	virtual void save( Snapshot& s_ ) const
+	{
+		Inherited::save( s_ );
+		s_ << _dx;
+	}
+	virtual void restore( Snapshot& s_ )
+	{
+		Inherited::restore( s_ );
+		s_ >> _dx;
+	}
 private:
 	int _dx;
 };
@@ -1906,6 +2483,16 @@ public:
 			_x += lround( SCALE_X * rangedRandom( -dxRange(), dxRange() ) );
 		Inherited::update();
 	}
+	virtual void save( Snapshot& s_ ) const
+	{
+		Inherited::save( s_ );
+		s_ << _up << _stamina;
+	}
+	virtual void restore( Snapshot& s_ )
+	{
+		Inherited::restore( s_ );
+		s_ >> _up >> _stamina;
+	}
 private:
 	bool _up;
 	int _stamina;
@@ -1935,6 +2522,16 @@ public:
 		else
 			_y += ceil( SCALE_Y * delta );
 	}
+	virtual void save( Snapshot& s_ ) const
+	{
+		Inherited::save( s_ );
+		s_ << _up;
+	}
+	virtual void restore( Snapshot& s_ )
+	{
+		Inherited::restore( s_ );
+		s_ >> _up;
+	}
 private:
 	bool _up;
 };
@@ -1945,7 +2542,7 @@ class Missile : public Object
 {
 	typedef Object Inherited;
 public:
-	Missile( int x_, int y_, Fl_Color color_ = FL_WHITE ) :
+	Missile( int x_ = 0, int y_ = 0, Fl_Color color_ = FL_WHITE ) :
 		Object( O_MISSILE, x_, y_, 0, ceil( 20. * SCALE_X ), ceil( 3. * SCALE_Y ) ),
 		_ox( x_ ),
 		_color( color_ )
@@ -1970,6 +2567,16 @@ public:
 			c = fl_darker( c );
 		fl_rectf( x(), y(), w(), h(), c );
 	}
+	virtual void save( Snapshot& s_ ) const
+	{
+		Inherited::save( s_ );
+		s_ << _ox << _color;
+	}
+	virtual void restore( Snapshot& s_ )
+	{
+		Inherited::restore( s_ );
+		s_ >> _ox >> _color;
+	}
 private:
 	int _ox;
 	Fl_Color _color;
@@ -1981,7 +2588,7 @@ class Bomb : public Object
 {
 	typedef Object Inherited;
 public:
-	Bomb( int x_, int y_ ) :
+	Bomb( int x_ = 0, int y_ = 0 ) :
 		Inherited( O_BOMB, x_, y_, "bomb.gif" ),
 		_dy( lround( SCALE_Y * 10 ) )
 	{
@@ -2004,6 +2611,16 @@ public:
 		Inherited::update();
 	}
 	virtual double timeout() const { return started() ? 0.05 : 0.1; }
+	virtual void save( Snapshot& s_ ) const
+	{
+		Inherited::save( s_ );
+		s_ << _dy;
+	}
+	virtual void restore( Snapshot& s_ )
+	{
+		Inherited::restore( s_ );
+		s_ >> _dy;
+	}
 private:
 	int _dy;
 };
@@ -2065,6 +2682,16 @@ public:
 			fl_line_style( 0 );
 		}
 	}
+	virtual void save( Snapshot& s_ ) const
+	{
+		Inherited::save( s_ );
+		s_ << _max_height << _bg_color << _disabled << _dx;
+	}
+	virtual void restore( Snapshot& s_ )
+	{
+		Inherited::restore( s_ );
+		s_ >> _max_height >> _bg_color >> _disabled >> _dx;
+	}
 private:
 	int _max_height;
 	Fl_Color _bg_color;
@@ -2088,8 +2715,9 @@ class Explosion : public Object
 			speed( speed_ * 4 ), color( color_ ), len( len_ ), multicolor( multicolor_ ),
 			valid( false ), dot( false )
 		{
-			end_r -= ( Random::pRand() % (int)end_r / 4 );
-			r = start_r + Random::pRand() % std::min( len, 5 );
+			Random::Xoshiro128& rng = Random::Cosmetic();
+			end_r -= ( rng() % (int)end_r / 4 );
+			r = start_r + rng() % std::min( len, 5 );
 			dot = len <= 5;
 			len = ceil( SCALE_Y * len );
 			speed *= SCALE_Y;
@@ -2134,6 +2762,9 @@ public:
 		_nColors( colors_ ? nColors_ : nbrOfItems( multicolors ) ),
 		_done( false )
 	{
+		// reserve for both explosion stages (see explode())
+		int r = lround( _radius / SCALE_Y );
+		_particles.reserve( ( r * r ) / 200 + ( r * r ) / 400 );
 		explode( true );
 		update();
 	}
@@ -2149,6 +2780,7 @@ public:
 
 		_done = true;
 		// update particle position/speed
+		Random::Xoshiro128& rng = Random::Cosmetic();
 		for ( size_t i = 0; i < p_.size(); i++ )
 		{
 			Particle& p = p_[i];
@@ -2159,7 +2791,7 @@ public:
 				double f = ( p.end_r - p.r ) / ( p.end_r - p.start_r );
 
 				if ( p.multicolor )
-					p.curr_color = _colors[ Random::pRand() % _nColors ];
+					p.curr_color = _colors[ rng.below( _nColors ) ];
 				else
 					p.curr_color = p.color;
 
@@ -2183,7 +2815,9 @@ public:
 			}
 			else
 			{
-				p_.erase( p_.begin() + i );
+				// order doesn't matter: replace by last particle
+				p_[i] = p_.back();
+				p_.pop_back();
 				i--;
 			}
 		}
@@ -2218,16 +2852,17 @@ public:
 		bool fallout = ( _type & FALLOUT );
 		int r = lround( _radius / SCALE_Y );
 		int particles = ( r * r ) / ( init_ ? 200 : 400 );
+		Random::Xoshiro128& rng = Random::Cosmetic();
 		for ( int i = 0; i < particles; i++ )
 		{
-			int speed = fallout ? Random::pRand() % 10 + 1 : Random::pRand() % 5 + 3;
+			int speed = fallout ? rng.below( 10 ) + 1 : rng.below( 5 ) + 3;
 			Fl_Color color = _colors[ 0 ];
 			bool multicolor = ( _type & MC );
 			_particles.push_back( Particle( _radius * ( dot + 1 ),
-				( _type & SPLASH ) ? Random::pRand() % 180 + 180 : Random::pRand() % 360,
+				( _type & SPLASH ) ? rng.below( 180 ) + 180 : rng.below( 360 ),
 				speed,
 				color,
-				( dot ? Random::pRand() % 3 + 3 : speed * 10 ), multicolor ) );
+				( dot ? rng.below( 3 ) + 3 : speed * 10 ), multicolor ) );
 		}
 	}
 	bool done() const { return _done; }
@@ -2390,6 +3025,198 @@ private:
 	bool _done;
 };
 
+static Fl_RGB_Image *scaleRGB( const uchar *src_, int w_, int h_, int d_,
+                               int W_, int H_, bool bilinear_ )
+//-------------------------------------------------------------------------------
+{
+	// NOTE: thread safe (used by ZoomFrames worker)
+	// fl_copy_image() can't be used here, as it depends on the global
+	// Fl_Image::RGB_scaling() (see startup.H).
+	// Nearest neighbour picks the same pixels as Fl_RGB_Image::copy().
+	// Bilinear samples at pixel centres (FLTK maps the corners), so the
+	// result is shifted by less than a source pixel and the last row and
+	// column are not stretched - not visible in a zoom animation.
+	uchar *dst = new uchar[ W_ * H_ * d_ ];
+	uchar *p = dst;
+	for ( int y = 0; y < H_; y++ )
+	{
+		double fy = bilinear_ ? ( y + .5 ) * h_ / H_ - .5 : 0.;
+		if ( fy < 0 ) fy = 0;
+		int y0 = bilinear_ ? min( (int)fy, h_ - 1 ) : y * h_ / H_;
+		int y1 = min( y0 + 1, h_ - 1 );
+		double ay = fy - y0;
+		for ( int x = 0; x < W_; x++ )
+		{
+			if ( !bilinear_ )
+			{
+				memcpy( p, src_ + ( y0 * w_ + x * w_ / W_ ) * d_, d_ );
+				p += d_;
+				continue;
+			}
+			double fx = ( x + .5 ) * w_ / W_ - .5;
+			if ( fx < 0 ) fx = 0;
+			int x0 = min( (int)fx, w_ - 1 );
+			int x1 = min( x0 + 1, w_ - 1 );
+			double ax = fx - x0;
+			const uchar *p00 = src_ + ( y0 * w_ + x0 ) * d_;
+			const uchar *p01 = src_ + ( y0 * w_ + x1 ) * d_;
+			const uchar *p10 = src_ + ( y1 * w_ + x0 ) * d_;
+			const uchar *p11 = src_ + ( y1 * w_ + x1 ) * d_;
+			for ( int c = 0; c < d_; c++ )
+			{
+				double v = ( p00[c] * ( 1 - ax ) + p01[c] * ax ) * ( 1 - ay ) +
+				           ( p10[c] * ( 1 - ax ) + p11[c] * ax ) * ay;
+				*p++ = (uchar)( v + .5 );
+			}
+		}
+	}
+	Fl_RGB_Image *image = new Fl_RGB_Image( dst, W_, H_, d_ );
+	image->alloc_array = 1;
+	return image;
+}
+
+//-------------------------------------------------------------------------------
+class ZoomFrames
+//-------------------------------------------------------------------------------
+{
+	// Immutable set of the scaled frames of a zoom animation. It is built
+	// once on a worker thread and shared by all animations with the same
+	// image and parameters. Frames already in the disk cache are mapped
+	// directly.
+public:
+	static const ZoomFrames *get( const FltImage& src_, int frames_, bool hq_,
+	                              double scalex0_, double scaley0_,
+	                              double scalex1_, double scaley1_ )
+	{
+		ostringstream os;
+		os << "zoom " << src_.name() << " " << frames_ << ( hq_ ? " hq " : " " )
+		   << scalex0_ << "/" << scaley0_ << " - " << scalex1_ << "/" << scaley1_;
+		static map<string, ZoomFrames *> sets;
+		ZoomFrames *&z = sets[ os.str() ];
+		if ( !z )
+			z = new ZoomFrames( os.str(), src_, frames_, hq_,
+			                    scalex0_, scaley0_, scalex1_, scaley1_ );
+		return z;
+	}
+	size_t size() const { return _w.size(); }
+	// Frame 'i_' or - while the worker is still busy - the latest finished
+	// frame before it (0 if there is none yet). Never waits for the worker.
+	Fl_Image *frame( size_t i_ ) const
+	{
+		if ( _building )
+		{
+			size_t built = __sync_fetch_and_add( &_built, 0 );
+			if ( built < _images.size() )
+			{
+				for ( size_t i = i_ + 1; i-- > 0; )
+					if ( !_pending[i] || i < built )
+						return _images[i];
+				return 0;
+			}
+			_building = false;
+		}
+		if ( !_images[ i_ ] && !_task )
+		{
+			// no worker: scale image (e.g. a pixmap) here
+#if FLTK_HAS_NEW_FUNCTIONS
+			Fl_Image::RGB_scaling( _hq ? FL_RGB_SCALING_BILINEAR : FL_RGB_SCALING_NEAREST );
+#endif
+			_images[ i_ ] = fl_copy_image( _src, _w[ i_ ], _h[ i_ ] );
+		}
+		return _images[ i_ ];
+	}
+private:
+	ZoomFrames( const string& id_, const FltImage& src_, int frames_, bool hq_,
+	            double scalex0_, double scaley0_, double scalex1_, double scaley1_ ) :
+		_name( id_ ),
+		_src_name( src_.name() ),
+		_hq( hq_ ),
+		_task( false ),
+		_building( false ),
+		_built( 0 ),
+		_images( frames_, (Fl_Image *)0 ),
+		_pending( frames_, false ),
+		_src( 0 ),
+		_src_w( 0 ),
+		_src_h( 0 ),
+		_src_d( 0 )
+	{
+		bool missing = false;
+		for ( int i = 0; i < frames_; i++ )
+		{
+			double scalex = ( ( scalex1_ - scalex0_ ) / frames_ ) * i + scalex0_;
+			double scaley = ( ( scaley1_ - scaley0_ ) / frames_ ) * i + scaley0_;
+			_w.push_back( src_.orig_w() * scalex );
+			_h.push_back( src_.orig_h() * scaley );
+			int d = 0;
+			const uchar *pixels = ImageCache::load( _src_name, tag(), _w[i], _h[i], d );
+			if ( pixels )
+				_images[i] = new Fl_RGB_Image( pixels, _w[i], _h[i], d );
+			else
+				missing = true;
+		}
+		if ( !missing )
+			return;
+		_src = src_.origDrawImage();	// (decodes image, if not yet done)
+		if ( !_src || _src->count() != 1 || _src->d() < 3 )
+			return;	// can only scale RGB images in background
+
+		// copy source pixels, so the worker does not depend on the image
+		_src_w = _src->w();
+		_src_h = _src->h();
+		_src_d = _src->d();
+#if FLTK_HAS_IMAGE_SCALING
+		if ( _src->data_w() != _src_w || _src->data_h() != _src_h )
+			return;
+#endif
+		int ld = _src->ld() ? _src->ld() : _src_w * _src_d;
+		const uchar *data = (const uchar *)_src->data()[0];
+		_src_pixels.resize( _src_w * _src_h * _src_d );
+		for ( int y = 0; y < _src_h; y++ )
+			memcpy( &_src_pixels[ y * _src_w * _src_d ], data + y * ld, _src_w * _src_d );
+		for ( int i = 0; i < frames_; i++ )
+			_pending[i] = !_images[i];
+		_task = true;
+		_building = true;
+		Startup::run( _name.c_str(), build, this );
+	}
+	const char *tag() const { return _hq ? "zoomhq" : "zoom"; }
+	static void build( void *d_ )
+	{
+		// worker thread: scale all missing frames and store them in disk cache
+		ZoomFrames *z = (ZoomFrames *)d_;
+		// (frames are published in order through '_built')
+		for ( size_t i = 0; i < z->_images.size(); i++ )
+		{
+			if ( z->_pending[i] && z->_w[i] > 0 && z->_h[i] > 0 )
+			{
+				Fl_RGB_Image *image = scaleRGB( &z->_src_pixels[0], z->_src_w, z->_src_h,
+				                                z->_src_d, z->_w[i], z->_h[i], z->_hq );
+				ImageCache::save( z->_src_name, z->tag(), *image );
+				z->_images[i] = image;
+			}
+			__sync_fetch_and_add( &z->_built, 1 );
+		}
+		vector<uchar>().swap( z->_src_pixels );
+	}
+private:
+	string _name;
+	string _src_name;
+	bool _hq;
+	bool _task;	// frames are scaled by a worker
+	mutable bool _building;	// worker not yet finished
+	mutable volatile size_t _built;	// number of frames finished by worker
+	mutable vector<Fl_Image *> _images;
+	vector<bool> _pending;	// frame is scaled by worker
+	vector<int> _w;
+	vector<int> _h;
+	Fl_Image *_src;
+	vector<uchar> _src_pixels;
+	int _src_w;
+	int _src_h;
+	int _src_d;
+};
+
 //-------------------------------------------------------------------------------
 class ImageAnimation
 //-------------------------------------------------------------------------------
@@ -2425,10 +3252,19 @@ public:
 		_frame( 0 ),
 		_x( 0 ),
 		_y( 0 ),
+		_frameSet( 0 ),
 		_image( 0 )
 	{
 		_src.get( image_.name().c_str() );
 	}
+	// Build the frames of an animation from 'r0_' to 'r1_' in the background,
+	// so they are ready when the animation is created later.
+	static void prepare( const FltImage &image_, const Rect& r0_, const Rect& r1_,
+	                     bool hq_ = true, int frames_ = 0 )
+	{
+		ImageAnimation a( image_, 1.0, hq_, frames_ );
+		a.setSizeMoveFromTo( r0_, r1_ );
+	}
 	void setMoveFrom( int x_, int y_ )
 	{
 		_x0 = x_ + _src.w() / 2;
@@ -2452,6 +3288,8 @@ public:
 		_scalex1 = scalex1_;
 		_scaley1 = scaley1_;
 		_set = true;
+		_frameSet = ZoomFrames::get( _src, _frames, _hq,
+		                             _scalex0, _scaley0, _scalex1, _scaley1 );
 	}
 	void setSizeMoveFromTo( int x0_, int y0_, int x1_, int y1_,
                            double scale0_, double scale1_ )
@@ -2471,8 +3309,6 @@ public:
 	~ImageAnimation()
 	{
 		stop();
-		for ( size_t i = 0; i < _cache.size(); i++ )
-			delete _cache[ i ];
 	}
 	void draw()
 	{
@@ -2492,9 +3328,7 @@ public:
 	{
 		Fl::remove_timeout( cb_update, this );
 		_done = true;
-		if ( _image )
-			_image->uncache();
-		_image = 0;
+		_image = 0;	// frames are shared, don't uncache
 		return _done;
 	}
 	bool update()
@@ -2509,21 +3343,7 @@ public:
 			int dy = _y1 - _y0;
 			_x = _x0 + ceil( ((double)dx / _frames) * _frame );
 			_y = _y0 + ceil( ((double)dy / _frames) * _frame );
-			if ( (int)_cache.size() <= _frame )	// not all frames cached yet
-			{
-				double scalex = ( ( _scalex1 - _scalex0 ) / _frames ) * _frame + _scalex0;
-				double scaley = ( ( _scaley1 - _scaley0 ) / _frames ) * _frame + _scaley0;
-#if FLTK_HAS_NEW_FUNCTIONS
-				Fl_Image::RGB_scaling( _hq ? FL_RGB_SCALING_BILINEAR : FL_RGB_SCALING_NEAREST );
-#endif
-//				_image = _src.origDrawImage()->copy( _src.orig_w() * scalex, _src.orig_h() * scaley );
-				_image = fl_copy_image( _src.origDrawImage(), _src.orig_w() * scalex, _src.orig_h() * scaley );
-				_cache.push_back( _image );
-			}
-			else
-			{
-				_image = _cache[ _frame ];
-			}
+			_image = _frameSet->frame( _frame );
 			_frame++;
 		}
 		return _done;
@@ -2556,7 +3376,7 @@ private:
 	int _frame;
 	int _x;
 	int _y;
-	vector<Fl_Image*> _cache;
+	const ZoomFrames *_frameSet;	// shared, not owned
 	Fl_Image *_image;
 };
 
@@ -2700,6 +3520,21 @@ public:
 	int max_ground;
 };
 
+//-------------------------------------------------------------------------------
+class Star
+//-------------------------------------------------------------------------------
+{
+public:
+	Star( int x_, int y_ ) :
+		x( x_ ),
+		y( y_ )
+	{
+	}
+	bool operator<( const Star& s_ ) const { return x < s_.x; }
+	int x;	// column in starfield plane
+	int y;	// height (from bottom)
+};
+
 //-------------------------------------------------------------------------------
 class Spaceship : public Object
 //-------------------------------------------------------------------------------
@@ -2788,6 +3623,16 @@ public:
 	void explosionColor( Fl_Color explosionColor_ ) { _explosionColor = explosionColor_; }
 	Fl_Color missileColor() const { return _missileColor; }
 	void missileColor( Fl_Color missileColor_ ) { _missileColor = missileColor_; }
+	virtual void save( Snapshot& s_ ) const
+	{
+		Inherited::save( s_ );
+		s_ << _accel << _decel;
+	}
+	virtual void restore( Snapshot& s_ )
+	{
+		Inherited::restore( s_ );
+		s_ >> _accel >> _decel;
+	}
 protected:
 	virtual void update()
 	{
@@ -2870,7 +3715,8 @@ class DemoData
 //-------------------------------------------------------------------------------
 {
 public:
-	DemoData() : _seed( 1 ), _ship( 0 ), _user_completed( 0 ), _classic( false ) {}
+	DemoData() : _seed( 1 ), _ship( 0 ), _user_completed( 0 ), _classic( false ),
+		_next( 0 ), _playback( false ) {}
 	void setShip( unsigned index_, int sx_, int sy_ )
 	{
 		while ( _data.size() <= index_ )
@@ -2900,12 +3746,9 @@ public:
 		_data[ index_ ].seed2 = seed2_;
 		_data[ index_ ].seed_set = true;
 	}
-	void set( unsigned index_, int sx_, int sy_, bool bomb_, bool missile_,
-	          uint32_t seed_, uint32_t seed2_ )
+	void reserve( size_t n_ )
 	{
-		DemoDataItem item( sx_, sy_, bomb_, missile_, seed_, seed2_ );
-		while ( _data.size() <= index_ )
-			_data.push_back( item );
+		_data.reserve( n_ );
 	}
 	void seed( uint32_t seed_ )
 	{
@@ -2923,37 +3766,22 @@ public:
 	{
 		_classic = classic_;
 	}
-	bool getShip( unsigned index_, int &sx_, int &sy_ ) const
-	{
-		if ( _data.size() > index_ )
-		{
-			sx_ = _data[ index_ ].sx;
-			sy_ = _data[ index_ ].sy;
-			return true;
-		}
-		return false;
-	}
-	bool getBomb( unsigned index_, bool& bomb_ ) const
-	{
-		if ( _data.size() > index_ )
-		{
-			bomb_ = _data[ index_ ].bomb;
-			return true;
-		}
-		return false;
-	}
-	bool getMissile( unsigned index_, bool& missile_ ) const
-	{
-		if ( _data.size() > index_ )
-		{
-			missile_ = _data[ index_ ].missile;
-			return true;
-		}
-		return false;
-	}
 	bool get( unsigned index_, int &sx_, int &sy_, bool& bomb_, bool& missile_,
 	          uint32_t& seed_, uint32_t& seed2_ ) const
 	{
+		if ( _playback )
+		{
+			DemoFile::Item item;
+			if ( !_reader.get( index_, item ) )
+				return false;
+			sx_ = item.sx;
+			sy_ = item.sy;
+			bomb_ = item.bomb;
+			missile_ = item.missile;
+			seed_ = item.seed;
+			seed2_ = item.seed2;
+			return true;
+		}
 		if ( _data.size() > index_ )
 		{
 			sx_ = _data[ index_ ].sx;
@@ -2966,6 +3794,40 @@ public:
 		}
 		return false;
 	}
+	// Load binary demo file image 'data_' for playback (see demo_file.H).
+	bool load( vector<unsigned char>& data_ )
+	{
+		clear();
+		if ( !_reader.open( data_ ) )
+			return false;
+		const DemoFile::Header& h = _reader.header();
+		_seed = h.seed;
+		_ship = h.ship;
+		_user_completed = h.flags & 0xffff;
+		_classic = ( h.flags >> 16 ) & 1;
+		_playback = true;
+		return true;
+	}
+	// Get next recorded item below index 'end_' (i.e. completed) once.
+	bool next( unsigned end_, DemoFile::Item& item_ )
+	{
+		if ( _playback || _next >= end_ || _next >= _data.size() )
+			return false;
+		const DemoDataItem& d = _data[ _next ];
+		if ( !_next || d.sx || d.sy || d.bomb || d.missile )
+		{
+			_last.sx = d.sx;
+			_last.sy = d.sy;
+			_last.bomb = d.bomb;
+			_last.missile = d.missile;
+			_last.seed = d.seed;
+			_last.seed2 = d.seed2;
+		}
+		// else: not recorded (DX > 1), repeat last item
+		_next++;
+		item_ = _last;
+		return true;
+	}
 	uint32_t seed() const
 	{
 		return _seed;
@@ -2989,17 +3851,24 @@ public:
 		_user_completed = 0;
 		_classic = false;
 		_data.clear();
+		_next = 0;
+		_reader.close();
+		_playback = false;
 	}
 	size_t size() const
 	{
-		return _data.size();
+		return _playback ? _reader.size() : _data.size();
 	}
 private:
 	uint32_t _seed;
 	unsigned _ship;
 	unsigned _user_completed;
 	bool _classic;
-	vector<DemoDataItem> _data;
+	vector<DemoDataItem> _data;	// recording
+	unsigned _next;	// next item for next()
+	DemoFile::Item _last;
+	bool _playback;
+	mutable DemoFile::Reader _reader;	// playback
 };
 
 //-------------------------------------------------------------------------------
@@ -3030,36 +3899,163 @@ public:
 		if ( id_.empty() )
 			return default_;
 
-		if ( find( id_ ) == end() )
-			return default_;
+		if ( find( id_ ) == end() )
+			return default_;
+
+		_found = true;
+		double value = rangedValue( this->dvalue( id_ ), min_, max_ );
+
+		return value;
+	}
+	const char* value( const string& id_, size_t max_, const char *default_ )
+	{
+		_found = false;
+		if ( id_.empty() )
+			return default_;
+
+		if ( find( id_ ) == end() )
+			return default_;
+
+		_found = true;
+		string& value = at( id_ );
+		if ( value.size() > max_ )
+			value.erase( max_ );
+
+		return value.c_str();
+	}
+	bool found() const { return _found; }
+	void found( bool found_ ) { _found = found_; }
+private:
+	bool _found;
+};
+
+static void loadParameter( istream& f_, IniParameter& ini_ )
+//-------------------------------------------------------------------------------
+{
+	string line;
+	size_t left_col = 0;
+	while ( getline( f_, line ) )
+	{
+		if ( isspace( line[0] ) )
+			continue;
+		if ( line[0] == ';' || line[0] == '/' || line[0] == '#' )
+			continue;
+		size_t pos = line.find( '=' );
+		if ( pos == string::npos )
+			continue;
+		string name = line.substr( 0, pos );
+		trim( name );
+		if ( name.empty() ) continue;
+		string value = line.substr( pos + 1 );
+		left_col = pos + 1;
+		string left( left_col, ' ' );
+		trim( value );
+		while ( value.size() && value[ value.size() - 1 ] == '\\' )
+		{
+			value.erase( value.size() - 1 );
+			getline( f_, line );
+			rtrim( line );
+			// try to keep indentation
+			if ( line.size() >= left_col && line.substr( 0, left_col ) == left )
+				line.erase( 0, left_col );
+			value.push_back( '\n' );
+			value += line;
+		}
+		DBG( "add ini parameter '" << name << "' = '" << value << "'" );
+		ini_[ name ] = value;
+	}
+}
+
+static bool loadParameterFile( const string& name_, IniParameter& ini_ )
+//-------------------------------------------------------------------------------
+{
+	AssetStream f( assets(), name_ );
+	if ( !f.is_open() )
+		return false;
+	loadParameter( f, ini_ );
+	return true;
+}
+
+//-------------------------------------------------------------------------------
+struct StartupData
+//-------------------------------------------------------------------------------
+{
+	// results of startup tasks (see startupTasks())
+	StartupData() : iniLoaded( false ) {}
+	bool iniLoaded;
+	IniParameter ini;
+	string lang;
+	IniParameter texts;
+};
+static StartupData startupData;
 
-		_found = true;
-		double value = rangedValue( this->dvalue( id_ ), min_, max_ );
+static void loadIniTask( void * )
+//-------------------------------------------------------------------------------
+{
+	string iniFileName( levelPath( "ini.txt" ) );
+	LOG( "iniFileName: '" << iniFileName << "'" );
+	startupData.iniLoaded = loadParameterFile( iniFileName, startupData.ini );
+	startupData.lang = startupData.ini.value( "lang", 3, "" );
+	if ( startupData.lang.size() )
+	{
+		string langFileName( homeDir() + "lang_" + startupData.lang + ".txt" );
+		LOG( "langFileName: '" << langFileName << "'" );
+		loadParameterFile( langFileName, startupData.texts );
+	}
+}
 
-		return value;
+static void readCfgTask( void * )
+//-------------------------------------------------------------------------------
+{
+	// Cfg (Fl_Preferences) must be created in the main thread, so just
+	// read the preferences file ahead into the file cache. Its location
+	// is guessed from FLTK's conventions (a wrong guess costs nothing).
+	vector<string> dirs;
+	const char *env = getenv( "XDG_CONFIG_HOME" );
+	if ( env && env[0] )
+		dirs.push_back( env );
+	env = getenv( "HOME" );
+	if ( env && env[0] )
+	{
+		dirs.push_back( (string)env + "/.config" );
+		dirs.push_back( (string)env + "/.fltk" );
 	}
-	const char* value( const string& id_, size_t max_, const char *default_ )
+	env = getenv( "APPDATA" );
+	if ( env && env[0] )
+		dirs.push_back( env );
+	for ( size_t i = 0; i < dirs.size(); i++ )
 	{
-		_found = false;
-		if ( id_.empty() )
-			return default_;
-
-		if ( find( id_ ) == end() )
-			return default_;
-
-		_found = true;
-		string& value = at( id_ );
-		if ( value.size() > max_ )
-			value.erase( max_ );
-
-		return value.c_str();
+		string name( dirs[i] + "/" + VENDOR + "/" + APPLICATION + ".prefs" );
+		ifstream f( name.c_str(), ios::binary );
+		char buf[ 4096 ];
+		while ( f.read( buf, sizeof( buf ) ) )
+			;
 	}
-	bool found() const { return _found; }
-	void found( bool found_ ) { _found = found_; }
-private:
-	bool _found;
+}
+
+//-------------------------------------------------------------------------------
+struct LevelGenerator
+//-------------------------------------------------------------------------------
+{
+	// state of internal level generation (continued in endless mode)
+	LevelGenerator() :
+		hardestFactor( 1. ), minGround( 0 ), bott( 0 ), range( 0 ),
+		X( 0 ), bott1( 0 ), last_x( -1 ), o( 0 ), retry( 3 ) {}
+	double hardestFactor;
+	int minGround;
+	int bott;
+	int range;
+	int X;	// x of next ground point
+	int bott1;	// ground level at X
+	int last_x;	// x of next object
+	int o;	// object to place
+	int retry;
+	string objects;	// shuffled object pool
+	vector<Point> points;	// ground points
 };
 
+struct terrain_data;
+
 //-------------------------------------------------------------------------------
 class FLTrator : public Fl_Double_Window
 //-------------------------------------------------------------------------------
@@ -3081,9 +4077,13 @@ public:
 	   NO_STATE
 	};
 	FLTrator( int argc_ = 0, const char *argv_[] = 0 );
+	friend class FLTratorBench;	// microbenchmarks
 	int run();
 	bool trainMode() const { return _trainMode; }
 	bool isFullscreen() const { return fullscreen_active() || !border(); }
+	// in upscale mode the game draws with logical screen size
+	int logicalW() const { return UPSCALE ? (int)SCREEN_W : w(); }
+	int logicalH() const { return UPSCALE ? (int)SCREEN_H : h(); }
 	bool gimmicks() const { return _gimmicks; }
 	void draw_fadeout();
 	void draw_tv() const;
@@ -3106,9 +4106,13 @@ private:
 	bool loadLevel( unsigned level_, string& levelFileName_ );
 	bool validDemoData( unsigned level_ = 0 );
 	unsigned pickRandomDemoLevel( unsigned minLevel_ = 0, unsigned maxLevel_ = 0 );
-	string demoFileName( unsigned  level_ = 0 ) const;
+	string demoFileName( unsigned  level_ = 0, const char *ext_ = ".dmo" ) const
+		{ return demoFileName( level_, ext_, _autopilot && _state != DEMO ); }
+	string demoFileName( unsigned  level_, const char *ext_, bool autopilot_ ) const;
 	bool loadDemoData( unsigned level_ = 0, bool dryrun_ = false );
-	bool saveDemoData() const;
+	bool loadDemoFile( const string& name_, bool binary_, bool dryrun_ );
+	bool saveDemoData();
+	bool recordDemo() const { return !_trainMode && !_no_demo && !_endless; }
 	bool collisionWithTerrain( const Object& o_ ) const;
 
 	void create_explosion( int x_, int y_, Explosion::ExplosionType type_,
@@ -3117,6 +4121,16 @@ private:
 	void create_objects();
 	void delete_objects();
 
+	void saveState( Snapshot& s_ ) const;
+	bool restoreState( Snapshot& s_ );
+	void checkpoint();
+	bool rewind( int minDist_ );
+	bool retryFromCheckpoint();
+
+	int bombDistance( int height_ ) const;
+	void autopilot();
+	void autopilotLevelEnd();
+
 	void check_bomb_hits();
 	void check_drop_hits();
 	void check_missile_hits();
@@ -3132,7 +4146,13 @@ private:
 	Fl_Image *background_as_image();
 #endif
 	bool create_terrain();
+	const terrain_data& levelData() const;
+	bool create_ground( int limit_ );
+	void create_sky( size_t from_ );
+	void place_objects( int limit_ );
 	void create_level();
+	void extend_level( int size_ );
+	void stream_terrain();
 	bool revert_level();
 
 	void draw_badies() const;
@@ -3161,6 +4181,7 @@ private:
 	bool draw_decoration();
 	void draw();
 	void do_draw();
+	void present();
 
 	string firstTimeSetup();
 
@@ -3207,6 +4228,12 @@ private:
 
 	bool zoominShip( bool updateOrigin_ );
 	bool zoomoutShip();
+	ImageAnimation::Rect zoomRect() const
+	{
+		// size/position of zoomed ship in title screen
+		return ImageAnimation::Rect( SCALE_X * 60, SCALE_Y * 40, logicalW() - SCALE_X * 120, logicalH() - SCALE_Y * 150 );
+	}
+	bool zoomHQ() const { return _effects > 1 && FPS >= 100; }
 
 	bool paused() const { return _state == PAUSED; }
 	void bombUnlock();
@@ -3223,7 +4250,9 @@ private:
 	bool classic() const { return _state == DEMO ? _demoData.classic() : _classic; }
 	unsigned user_completed() const { return _state == DEMO ? _demoData.user_completed() : _user.completed; }
 	unsigned endLevel() const { return reversLevel() ? 1 : MAX_LEVEL; }
-	bool reversLevel() const { return _internal_levels ? false : ( user_completed() % 2 != 0 ); }
+	// NOTE: no reverse levels with internal levels (and so in endless mode,
+	//       whose terrain is created forward while playing)
+	bool reversLevel() const { return _internal_levels || _endless ? false : ( user_completed() % 2 != 0 ); }
 	int levelIncrement() const { return reversLevel() ? -1 : 1; }
 
 	void setPaused( bool paused_ );
@@ -3234,15 +4263,20 @@ private:
 	void startBgSound( bool checkForRepeat_ = false ) const;
 	void flt_draw( const char* buf_, int n_, int x_, int y_, int &sx_, int &sy_ )
 	{
+		// NOTE: text is only rasterized again, when it changes
+		const TextCache::Sprite *sprite = TextCache::get( buf_, n_, fl_color() );
 		x_ = lround( SCALE_X * x_ );
 		y_ = lround( SCALE_Y * y_ );
 		if ( x_ < 0 )
-			x_ = w() - fl_width( buf_ ) + x_;
+			x_ = logicalW() - ( sprite ? sprite->width : fl_width( buf_ ) ) + x_;
 		if ( y_ < 0 )
-			y_ = h() + y_;
+			y_ = logicalH() + y_;
 		sx_ = x_;
 		sy_ = y_;
-		fl_draw( buf_, n_, x_, y_ );
+		if ( sprite )
+			sprite->draw( x_, y_ );
+		else
+			fl_draw( buf_, n_, x_, y_ );
 	}
 	void flt_draw( const char* buf_, int n_, int x_, int y_ )
 	{
@@ -3251,7 +4285,8 @@ private:
 	}
 protected:
 	Terrain T;
-	Terrain TBG;
+	vector<Star> Stars;	// starfield plane (sorted by x)
+	vector<short> Mountains;	// parallax plane ground levels (already * 2/3)
 	vector<Missile *> Missiles;
 	vector<Bomb *> Bombs;
 	vector<Rocket *> Rockets;
@@ -3337,6 +4372,13 @@ private:
 	Cfg *_cfg;
 	unsigned _speed_right;
 	bool _internal_levels;
+	bool _endless;	// endless internal level (terrain is created while playing)
+	LevelGenerator _gen;
+	bool _autopilot;	// ship is steered by autopilot
+	unsigned _autopilot_levels;	// stop after this number of levels (0 = never)
+	int _autopilot_home;	// ship x at level start
+	Autopilot _pilot;
+	Autopilot::World _pilot_world;
 	bool _enable_boss_key; // ESC
 	bool _focus_out;
 	bool _no_random;
@@ -3368,6 +4410,16 @@ private:
 	bool _exit_demo_on_collision; // set to true, if demo should end at collision
 	bool _dimmout;
 	bool _about;
+	Fl_Offscreen _offscreen;	// upscale mode: drawing buffer with logical size
+	vector<uchar> _present_buf;	// upscale mode without scaled blit: read back pixels
+	vector<uchar> _scaled_buf;
+#if FLTK_HAS_IMAGE_SCALING
+	Fl_RGB_Image *_present_image;	// wraps _present_buf
+#endif
+	mutable vector<uchar> _collision_buf;	// screen area read by collisionWithTerrain()
+	int _present_x, _present_y, _present_w, _present_h;
+	vector<unsigned> _levelObjects;	// object bits of level at start (for restoreState())
+	SnapshotRing _snapshots;	// checkpoints (practice mode and demo)
 };
 
 /*static*/ Fl_Waiter FLTrator::_waiter;
@@ -3549,6 +4601,10 @@ FLTrator::FLTrator( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 	_cfg( 0 ),
 	_speed_right( 0 ),
 	_internal_levels( false ),
+	_endless( false ),
+	_autopilot( false ),
+	_autopilot_levels( 0 ),
+	_autopilot_home( 0 ),
 	_enable_boss_key( false ),
 	_focus_out( true ),
 	_no_random( false ),
@@ -3568,7 +4624,16 @@ FLTrator::FLTrator( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 	_TO( 0. ),
 	_exit_demo_on_collision( false ),
 	_dimmout( false ),
-	_about( false )
+	_about( false ),
+	_offscreen( 0 ),
+#if FLTK_HAS_IMAGE_SCALING
+	_present_image( 0 ),
+#endif
+	_present_x( 0 ),
+	_present_y( 0 ),
+	_present_w( 0 ),
+	_present_h( 0 ),
+	_snapshots( 16 )
 {
 	end();
 	_DX = DX;
@@ -3580,6 +4645,8 @@ FLTrator::FLTrator( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 	bool usage( false );
 	bool info( false );
 	bool fullscreen( false );
+	string screenSize;
+	bool setScreenSize( false );
 
 	// read ini file
 	loadDefaultIniParameter();
@@ -3603,6 +4670,7 @@ FLTrator::FLTrator( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 
 	string defaultArgs;
 	string cfgName( APPLICATION );
+	Startup::wait( "cfg" );	// preferences file is read ahead by a startup task
 	_cfg = new Cfg( VENDOR, cfgName.c_str() );
 	char *value = 0;
 	int ret = _cfg->get( "defaultArgs", value, "" );
@@ -3689,6 +4757,13 @@ FLTrator::FLTrator( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 		if ( arg.find( "--" ) == 0 )
 		{
 			string longopt = arg.substr( 2 );
+			string longval;
+			size_t pos = longopt.find( '=' );
+			if ( pos != string::npos )
+			{
+				longval = longopt.substr( pos + 1 );
+				longopt.erase( pos );
+			}
 			if ( (string("help")).find( longopt ) == 0 || "-h" == arg )
 			{
 				usage = true;
@@ -3708,6 +4783,28 @@ FLTrator::FLTrator( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 			{
 				_classic = true;
 			}
+			else if ( (string("endless")).find( longopt ) == 0 )
+			{
+				_endless = true;
+				_internal_levels = true;
+				_no_demo = true;
+			}
+			else if ( (string("autopilot")).find( longopt ) == 0 )
+			{
+				_autopilot = true;
+				_autopilot_levels = atoi( longval.c_str() );
+				_enable_boss_key = true;	// otherwise no exit!
+				_focus_out = false;	// keeps running in background
+			}
+			else if ( (string("startup-trace")).find( longopt ) == 0 )
+			{
+				STARTUP_TRACE = true;
+			}
+			else if ( (string("upscale")).find( longopt ) == 0 &&
+			          ( longval.empty() || longval == "nearest" || longval == "bilinear" ) )
+			{
+				UPSCALE = longval == "bilinear" ? 2 : 1;
+			}
 			else
 			{
 				unknown_option = arg;
@@ -3734,20 +4831,9 @@ FLTrator::FLTrator( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 		}
 		else if ( arg.find( "-W" ) == 0 )
 		{
-			int W, H;
-			if ( setupScreenSize( arg.substr( 2 ), W, H ) )
-			{
-				// TODO: leak
-				FltImage::uncache();
-				_rocket = *new Rocket();
-				_phaser = *new Phaser();
-				_radar = *new Radar();
-				_drop = *new Drop();
-				_bady = *new Bady();
-				_cumulus = *new Cumulus();
-				size( W, H );
-				setup( FPS, _HAVE_SLOW_CPU, _USE_FLTK_RUN );
-			}
+			// applied after all options are known (--upscale may follow)
+			screenSize = arg.substr( 2 );
+			setScreenSize = true;
 		}
 		else if ( arg[0] == '-' )
 		{
@@ -3838,6 +4924,23 @@ FLTrator::FLTrator( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 		cout << "Invalid option: '" << unknown_option.c_str() << "'" << endl << endl;
 		usage = true;
 	}
+	if ( setScreenSize && !usage )
+	{
+		int W, H;
+		if ( setupScreenSize( screenSize, W, H ) )
+		{
+			// TODO: leak
+			FltImage::uncache();
+			_rocket = *new Rocket();
+			_phaser = *new Phaser();
+			_radar = *new Radar();
+			_drop = *new Drop();
+			_bady = *new Bady();
+			_cumulus = *new Cumulus();
+			size( W, H );
+			setup( FPS, _HAVE_SLOW_CPU, _USE_FLTK_RUN );
+		}
+	}
 	if ( usage )
 	{
 		const char *name = fl_filename_name( argv_[0] );
@@ -3875,16 +4978,24 @@ FLTrator::FLTrator( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 		     << "  -Wf\tuse full screen area as screen size" << endl
 		     << "  -X\tturn off explosion sounds (for a more chilled experience)" << endl
 		     << endl
+		     << "  --autopilot[=levels]\tlet the ship be steered automatically (for soak tests)" << endl
+		     << "   \tand print statistics (stop after 'levels' levels)" << endl
 		     << "  --classic\tplay in classic look (same color for landscape/sky/ground + outline)" << endl
+		     << "  --endless\tplay an endless internal level (difficulty of start level)" << endl
 		     << "  --help\tprint out this text and exit" << endl
 		     << "  --info\tprint out some runtime information and exit" << endl
 		     << "  --setup\tstart for (another) 'first time setup'" << endl
+		     << "  --startup-trace\tprint a timeline of the startup tasks at first title screen" << endl
+		     << "  --upscale[=nearest|bilinear]\tdraw at fixed resolution and scale up to window size" << endl
+		     << "   \t(e.g. -W800x600 for 800x600 or -Wf for a fraction of the screen size)" << endl
 		     << "  --version\tprint out version  and exit" << endl;
 		exit( EXIT_SUCCESS );
 	}
 
 	if ( _internal_levels )
 		cfgName += "_internal";	// don't mix internal levels with real levels
+	if ( _autopilot )
+		cfgName += "_autopilot";	// don't mix autopilot scores with player scores
 	_cfg = new Cfg( VENDOR, cfgName.c_str() );
 
 	if ( info )
@@ -3899,6 +5010,7 @@ FLTrator::FLTrator( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 		     << "Default cmd   = '" << defaultArgsSave << "'" << endl
 		     << "Audio::cmd    = '" << Audio::instance()->cmd() << "'" << endl
 		     << "Audio::bg_cmd = '" << Audio::instance()->cmd( true ) << "'" << endl
+		     << "Upscale       = " << ( UPSCALE == 2 ? "bilinear" : UPSCALE ? "nearest" : "off" ) << endl
 		     << "FLTK version  = " << Fl::version() << endl;
 #if FLTK_USE_WAYLAND || FLTK_USE_X11
 		cout << "Wayland sess. = " << ( wayland_session() ?  "yes" : "no" ) << endl;
@@ -3966,10 +5078,11 @@ FLTrator::FLTrator( int argc_/* = 0*/, const char *argv_[]/* = 0*/ ) :
 	wavPath.ext( Audio::instance()->ext() );
 
 	fl_make_path( demoPath().c_str() );	// create demo path for sure
+	demoJournal().open( demoPath() );
 
 	Fl::visual( FL_DOUBLE | FL_RGB );
 
-	resizable( fullscreen ? this : 0 );
+	resizable( fullscreen || UPSCALE ? this : 0 );
 	setFullscreen( fullscreen );
 	show();
 }
@@ -4013,6 +5126,12 @@ void FLTrator::onStateChange( State from_state_ )
 		case LEVEL:
 			_dimmout = false;
 			onNextScreen( ( from_state_ != PAUSED || _done ) );
+			_demoData.reserve( T.size() );	// recorded every frame
+			if ( _autopilot && _state == LEVEL )
+			{
+				_autopilot_home = _spaceship->x();
+				_pilot.levelStart( Startup::now() );
+			}
 			break;
 		case DEMO:
 //			NOTE: if intro music should stop at demo:
@@ -4036,6 +5155,8 @@ void FLTrator::onStateChange( State from_state_ )
 			// FALLTHROUGH
 		case LEVEL_DONE:
 		{
+			if ( _autopilot )
+				autopilotLevelEnd();
 			if ( _state == LEVEL_DONE )
 			{
 				Audio::instance()->stop_bg();
@@ -4061,7 +5182,7 @@ void FLTrator::onStateChange( State from_state_ )
 			double TO = _defaultIniParameter.value( "wait_time_fail", 1.0, 5.0, 2.0 );
 			if ( _state == LEVEL_FAIL && _level_repeat + 1 > MAX_LEVEL_REPEAT )
 				TO *= 2;
-			if ( _state == LEVEL_DONE && _level == _end_level )
+			if ( _state == LEVEL_DONE && _level == _end_level && !_autopilot )
 				TO = 60.0;
 			_TO = TO;
 			Fl::add_timeout( TO, cb_paused, this );
@@ -4093,7 +5214,7 @@ FLTrator::State FLTrator::changeState( State toState_/* = NEXT_STATE*/,
 			case SCORE:
 			case DEMO:
 				setPaused( false );
-				_state = _trainMode ? LEVEL : TITLE;
+				_state = _trainMode || _autopilot ? LEVEL : TITLE;
 				break;
 			case PAUSED:
 				if ( G_paused )
@@ -4118,7 +5239,7 @@ FLTrator::State FLTrator::changeState( State toState_/* = NEXT_STATE*/,
 	}
 	else
 	{
-		if ( toState_ == TITLE && _trainMode )
+		if ( toState_ == TITLE && ( _trainMode || _autopilot ) )
 			toState_ = LEVEL;
 		if ( state != toState_ )
 			_state = toState_;
@@ -4141,10 +5262,10 @@ void FLTrator::position_spaceship()
 	int X = _spaceship->w() + 10; // on left side of terrain
 	int ground = T[X].ground_level();
 	int sky = T[X].sky_level();
-	int Y = ground + ( h() - ground - sky ) / 2; // halfway between ground/sky
+	int Y = ground + ( logicalH() - ground - sky ) / 2; // halfway between ground/sky
 	// position center of spaceship at X/Y
 	_spaceship->cx( X );
-	_spaceship->cy( h() - Y );
+	_spaceship->cy( logicalH() - Y );
 }
 
 void FLTrator::addScrollinZone()
@@ -4152,7 +5273,7 @@ void FLTrator::addScrollinZone()
 {
 	T.insert( T.begin(), T[0] );	// this makes size() an odd number
 	T[0].object( 0 ); // ensure there are no objects in scrollin zone!
-	for ( int i = 0; i < w() / 2 - 1; i++ ) // -1 to correct size() to even number
+	for ( int i = 0; i < logicalW() / 2 - 1; i++ ) // -1 to correct size() to even number
 		T.insert( T.begin(), T[0] );
 	_final_xoff = T.size();
 }
@@ -4161,7 +5282,7 @@ void FLTrator::addScrolloutZone()
 //-------------------------------------------------------------------------------
 {
 	_final_xoff = T.size();
-	size_t minTerrainWidth = T.size() + w() + w() / 2;
+	size_t minTerrainWidth = T.size() + logicalW() + logicalW() / 2;
 	T.push_back( T.back() );
 	T.back().object( 0 ); // ensure there are no objects in scrollout zone!
 	while ( T.size() < minTerrainWidth )
@@ -4192,13 +5313,19 @@ bool FLTrator::collisionWithTerrain( const Object& o_ ) const
 		H -= yoff;
 	}
 
-	W = X - xoff + W < w() ? W : w() - ( X - xoff );
-	H = Y - yoff + H < h() ? H : h() - ( Y - yoff );
-
-	// read image from screen
-	const uchar *screen = fl_read_image( 0, X, Y, W, H );
+	W = X - xoff + W < logicalW() ? W : logicalW() - ( X - xoff );
+	H = Y - yoff + H < logicalH() ? H : logicalH() - ( Y - yoff );
 
+	// read image from screen (into reused buffer)
+	if ( W <= 0 || H <= 0 )
+		return false;
 	static const int d = 3;
+	if ( _collision_buf.size() < (size_t)( W * H * d ) )
+		_collision_buf.resize( W * H * d );
+	const uchar *screen = fl_read_image( &_collision_buf[0], X, Y, W, H );
+	if ( !screen )
+		return false;
+
 	bool collided = false;
 
 	// get current background color r/g/b
@@ -4226,7 +5353,6 @@ bool FLTrator::collisionWithTerrain( const Object& o_ ) const
 		}
 		if ( collided ) break;
 	}
-	delete[] screen;
 
 	return collided;
 } // collisionWithTerrain
@@ -4378,19 +5504,20 @@ void FLTrator::init_parameter()
 	_phaser_dx_range = iniValue( phaser_dx_range,0, 10, 0 );
 }
 
-string FLTrator::demoFileName( unsigned level_/* = 0*/ ) const
+string FLTrator::demoFileName( unsigned level_, const char *ext_, bool autopilot_ ) const
 //-------------------------------------------------------------------------------
 {
 	ostringstream os;
 	int level = level_ ? level_ : _level;
 	assert( level );
 	os << ( _internal_levels ? "di" : "d" ) /* << ( _user.completed ? "c" : "" ) */
+	   << ( autopilot_ ? "a" : "" )
 	   << ( ( SCREEN_W != SCREEN_NORMAL_W || SCREEN_H != SCREEN_NORMAL_H ) ?
-	      ( string( "_" ) + asString( w() ) + (string)"x" + asString( h() ) ) : "" )
+	      ( string( "_" ) + asString( logicalW() ) + (string)"x" + asString( logicalH() ) ) : "" )
 	   << "_" << level;
 	if ( 1 != DX )
 		os << "_" << DX;
-	os << ".txt";
+	os << ext_;
 	return demoPath( os.str() );
 }
 
@@ -4429,101 +5556,75 @@ bool FLTrator::loadDemoData( unsigned level_/* = 0*/, bool dryrun_/* = false*/ )
 		_demoData.clear();
 		_demoData.ship( _ship );
 	}
-	ifstream f( demoFileName( level_ ).c_str() );
+	// demo files are recorded by the game, so a file has precedence,
+	// binary demos have precedence over text demos (older versions),
+	// demos of a player have precedence over autopilot demos ('da_...')
+	for ( int autopilot = 0; autopilot < 2; autopilot++ )
+	{
+		string bin( demoFileName( level_, ".dmo", autopilot ) );
+		string txt( demoFileName( level_, ".txt", autopilot ) );
+		if ( access( bin.c_str(), R_OK ) == 0 || access( txt.c_str(), R_OK ) != 0 )
+		{
+			if ( loadDemoFile( bin, true, dryrun_ ) || loadDemoFile( txt, false, dryrun_ ) )
+				return true;
+		}
+		else if ( loadDemoFile( txt, false, dryrun_ ) || loadDemoFile( bin, true, dryrun_ ) )
+			return true;
+	}
+	return false;
+}
+
+bool FLTrator::loadDemoFile( const string& name_, bool binary_, bool dryrun_ )
+//-------------------------------------------------------------------------------
+{
+	AssetStream f( assets(), name_, ios::in | ios::binary, true );
 	if ( !f.is_open() )
 		return false;
-	uint32_t seed;
-	unsigned int dx;
-	f >> seed;
-	int ship;
-	f >> ship;
-	f >> dx;
-	if ( DX != dx )
+	DemoFile::Header header;
+	vector<unsigned char> data;
+	vector<DemoFile::Item> items;
+	if ( binary_ )
+	{
+		DemoFile::read( f, data );
+		if ( !DemoFile::readHeader( data.empty() ? 0 : &data[0], data.size(), header ) )
+			return false;
+	}
+	else if ( !DemoFile::readText( f, header, dryrun_ ? 0 : &items ) )
+		return false;
+	if ( DX != header.dx )
 		return false;
 	if ( dryrun_ )
 		return true;
-	LOG( "Using demo data " <<  demoFileName() );
-	_demoData.seed( seed );
-	unsigned long flags;
-	f >> flags;
-	unsigned user_completed( flags & 0xffff );
-	bool classic( ( flags >> 16 ) & 1 );
-	bool correct_speed( ( flags >> 17 ) & 1 );
-	_exit_demo_on_collision = correct_speed;
-	_demoData.ship( ship );
-	_demoData.user_completed( user_completed );
-	_demoData.classic( classic );
-	int index = 0;
-	while ( f.good() )
+	LOG( "Using demo data " << name_ );
+	if ( !binary_ )
+		DemoFile::encode( header, items, data );
+	if ( !_demoData.load( data ) )
 	{
-		int sx, sy;
-		bool bomb, missile;
-		uint32_t seed, seed2;
-		f >> sx;
-		f >> sy;
-		f >> bomb;
-		f >> missile;
-		int c = f.peek();	// have value for seed?
-		if ( ' ' == c || '\t' == c )
-		{
-			f >> seed;
-			f >> seed2;
-		}
-		if ( !f.good() ) break;
-		while ( f.good() )
-		{
-			_demoData.set( index, sx, sy, bomb, missile, seed, seed2 );
-			index++;
-			c = (f >> std::ws).peek(); // (peek one character skipping whitespace)
-			if ( '*' != c ) break;
-			f.get();
-		}
+		PERR( "demo " << name_ << " is corrupt" );
+		return false;
 	}
+	bool correct_speed( ( header.flags >> 17 ) & 1 );
+	_exit_demo_on_collision = correct_speed;
 	return true;
 }
 
-bool FLTrator::saveDemoData() const
+bool FLTrator::saveDemoData()
 //-------------------------------------------------------------------------------
 {
-	ofstream f( demoFileName().c_str() );
-	if ( !f.is_open() )
-		return false;
+	// written by journal thread
 	LOG( "save to demo data " << demoFileName() );
-	f << _demoData.seed() << endl;
-	f << _ship << endl;
-	f << DX << endl;
+	DemoFile::Item item;
+	while ( _demoData.next( _demoData.size(), item ) )
+		demoJournal().add( item );
+	DemoFile::Header header;
+	header.seed = _demoData.seed();
+	header.ship = _ship;
+	header.dx = DX;
 	unsigned user_completed( _user.completed );
 	if ( _level == _end_level && user_completed )	// save last level with corrected completed
 		user_completed--;
-	unsigned flags( user_completed | ( _classic << 16 ) | ( _correct_speed << 17 ) );
-	f << flags << endl;
-	int index = 0;
-	int osx( 0 ), osy( 0 );
-	bool obomb( false ), omissile( false );
-	uint32_t oseed( 0 );
-	uint32_t oseed2( 0 );
-	while ( f.good() )
-	{
-		int sx, sy;
-		bool bomb, missile;
-		uint32_t seed, seed2;
-		if ( !_demoData.get( index, sx, sy, bomb, missile, seed, seed2 ) )
-			break;
-		if ( ( index && sx == 0 && sy == 0 && bomb == 0 && missile == 0 ) ||
-		     ( index && sx == osx && sy == osy && obomb == bomb && omissile == missile &&
-		     oseed == seed && oseed2 == seed2 ) )
-			f << '*';	// data repeat
-		else
-		{
-			if ( seed == oseed && seed2 == oseed2 )
-				f << sx << " " << sy << " " << bomb << " " << missile << endl;
-			else
-				f << sx << " " << sy << " " << bomb << " " << missile << " "
-				  << seed << " " << seed2 << endl;
-			osx = sx; osy = sy; obomb = bomb; omissile = missile; oseed = seed; oseed2 = seed2;
-		}
-		index++;
-	}
+	header.flags = user_completed | ( _classic << 16 ) | ( _correct_speed << 17 );
+	demoJournal().finish( header );
 	return true;
 }
 
@@ -4542,7 +5643,7 @@ static istream& readColor( istream& s_, Fl_Color& c_ )
 	return s_;
 }
 
-static ifstream& readColors( ifstream& f_, Fl_Color& c_, vector<Fl_Color>& alt_ )
+static istream& readColors( istream& f_, Fl_Color& c_, vector<Fl_Color>& alt_ )
 //-------------------------------------------------------------------------------
 {
 	string line;
@@ -4562,53 +5663,13 @@ static ifstream& readColors( ifstream& f_, Fl_Color& c_, vector<Fl_Color>& alt_
 	return f_;
 }
 
-static void loadParameter( ifstream& f_, IniParameter& ini_ )
-//-------------------------------------------------------------------------------
-{
-	string line;
-	size_t left_col = 0;
-	while ( getline( f_, line ) )
-	{
-		if ( isspace( line[0] ) )
-			continue;
-		if ( line[0] == ';' || line[0] == '/' || line[0] == '#' )
-			continue;
-		size_t pos = line.find( '=' );
-		if ( pos == string::npos )
-			continue;
-		string name = line.substr( 0, pos );
-		trim( name );
-		if ( name.empty() ) continue;
-		string value = line.substr( pos + 1 );
-		left_col = pos + 1;
-		string left( left_col, ' ' );
-		trim( value );
-		while ( value.size() && value[ value.size() - 1 ] == '\\' )
-		{
-			value.erase( value.size() - 1 );
-			getline( f_, line );
-			rtrim( line );
-			// try to keep indentation
-			if ( line.size() >= left_col && line.substr( 0, left_col ) == left )
-				line.erase( 0, left_col );
-			value.push_back( '\n' );
-			value += line;
-		}
-		DBG( "add ini parameter '" << name << "' = '" << value << "'" );
-		ini_[ name ] = value;
-	}
-}
-
 bool FLTrator::loadDefaultIniParameter()
 //-------------------------------------------------------------------------------
 {
-	string iniFileName( levelPath( "ini.txt" ) );
-	LOG( "iniFileName: '" << iniFileName << "'" );
-	ifstream f( iniFileName.c_str() );
-	if ( !f.is_open() )
-		return false;
-	loadParameter( f, _defaultIniParameter );
-	return true;
+	if ( !Startup::wait( "ini" ) )
+		loadIniTask( 0 );
+	_defaultIniParameter = startupData.ini;
+	return startupData.iniLoaded;
 }
 
 bool FLTrator::loadTranslations()
@@ -4617,13 +5678,15 @@ bool FLTrator::loadTranslations()
 	if ( _lang.empty() )
 		return false;
 
+	if ( _lang == startupData.lang )
+	{
+		// already loaded with ini file
+		_texts = startupData.texts;
+		return !_texts.empty();
+	}
 	string langFileName( homeDir() + "lang_" + _lang + ".txt" );
 	LOG( "langFileName: '" << langFileName << "'" );
-	ifstream f( langFileName.c_str() );
-	if ( !f.is_open() )
-		return false;
-	loadParameter( f, _texts );
-	return true;
+	return loadParameterFile( langFileName, _texts );
 }
 
 bool FLTrator::loadLevel( unsigned level_, string& levelFileName_ )
@@ -4637,7 +5700,8 @@ bool FLTrator::loadLevel( unsigned level_, string& levelFileName_ )
 		levelFileName = levelPath( os.str() );
 		levelFileName_ = levelFileName;
 	}
-	ifstream f( levelFileName.c_str() );
+	// levels may be edited with the landscape editor, so a file has precedence
+	AssetStream f( assets(), levelFileName, ios::in, true );
 	if ( !f.is_open() )
 		return false;
 	// read from level file...
@@ -4731,13 +5795,13 @@ Fl_Image *FLTrator::terrain_as_image()
 //-------------------------------------------------------------------------------
 {
 	int W = T.size();
-	int H = h();
+	int H = logicalH();
 	Fl_Image_Surface *img_surf = new Fl_Image_Surface( W, H );
 	assert( img_surf );
 	img_surf->set_current();
 
 	// draw bg
-	fl_rectf( 0, 0, W, h(), T.bg_color );
+	fl_rectf( 0, 0, W, logicalH(), T.bg_color );
 
 	// draw landscape
 	draw_landscape( 0, W );
@@ -4753,7 +5817,7 @@ static void color_to_transparence( Fl_Image *img_, Fl_Color c_, uchar alpha_ = 0
 //-------------------------------------------------------------------------------
 {
 	assert( img_ );
-	if ( img_->d() < 3 )
+	if ( img_->d() < 4 )
 		return;
 
 	uchar r, g, b;
@@ -4762,16 +5826,8 @@ static void color_to_transparence( Fl_Image *img_, Fl_Color c_, uchar alpha_ = 0
 #if FLTK_HAS_IMAGE_SCALING
 	assert( img_->w() == img_->data_w() && img_->h() == img_->data_h() );
 #endif
-	uchar *p = (uchar *)img_->data()[0];
-	uchar *e = p + img_->w() * img_->h() * img_->d();
-	while ( p < e )
-	{
-		if ( p[0] == r && p[1] == g && p[2] == b )
-		{
-			p[3] = alpha_; // set color c_ alpha value (0 = max. transparency)
-		}
-		p += 4;
-	}
+	// set color c_ alpha value (0 = max. transparency)
+	Pixels::colorKey( (uchar *)img_->data()[0], (size_t)img_->w() * img_->h(), r, g, b, alpha_ );
 }
 
 static void faintout_rgb_image( Fl_Image *img_ )
@@ -4781,19 +5837,15 @@ static void faintout_rgb_image( Fl_Image *img_ )
 	if ( img_->d() < 3 )
 		return;
 
-	uchar *p = (uchar *)img_->data()[0];
 #if FLTK_HAS_IMAGE_SCALING
-	uchar *e = p + img_->data_w() * img_->data_h() * img_->d();
+	size_t n = (size_t)img_->data_w() * img_->data_h();
 #else
-	uchar *e = p + img_->w() * img_->h() * img_->d();
+	size_t n = (size_t)img_->w() * img_->h();
 #endif
-	while ( p < e )
-	{
-		Fl_Color c( fl_rgb_color( p[0], p[1], p[2] ) );
-		Fl_Color a = fl_color_average( FL_GRAY, c, 0.3 );
-		Fl::get_color( a, p[0], p[1], p[2] );
-		p += 4;
-	}
+	// same as fl_color_average( FL_GRAY, pixel, 0.3 ) for each pixel
+	uchar r, g, b;
+	Fl::get_color( FL_GRAY, r, g, b );
+	Pixels::blend( (uchar *)img_->data()[0], n, img_->d(), r, g, b, 0.3 );
 }
 
 static Fl_RGB_Image *read_RGBA_image( int W_, int H_ )
@@ -4811,12 +5863,12 @@ Fl_Image *FLTrator::background_as_image()
 //-------------------------------------------------------------------------------
 {
 	int W = T.size();
-	int H = h();
+	int H = logicalH();
 	Fl_Image_Surface img_surf( W, H );
 	img_surf.set_current();
 
 	// set screen to white to be used for transparency
-	fl_rectf( 0, 0, W, h(), BlueBoxColor );
+	fl_rectf( 0, 0, W, logicalH(), BlueBoxColor );
 
 	if ( _effects > 1 && !classic() )
 	{
@@ -4827,7 +5879,7 @@ Fl_Image *FLTrator::background_as_image()
 		fl_color( T.bg_color );
 		for ( int i = 0; i < W; i++ )
 		{
-			fl_yxline( i, T[i].sky_level(), h() - T[i].ground_level() );
+			fl_yxline( i, T[i].sky_level(), logicalH() - T[i].ground_level() );
 		}
 	}
 	Fl_Image *image = read_RGBA_image( W, H );
@@ -4841,7 +5893,7 @@ Fl_Image *FLTrator::landscape_as_image()
 //-------------------------------------------------------------------------------
 {
 	int W = T.size();
-	int H = h();
+	int H = logicalH();
 	Fl_Image_Surface img_surf( W, H );
 	img_surf.set_current();
 
@@ -4855,7 +5907,7 @@ Fl_Image *FLTrator::landscape_as_image()
 	else
 	{
 		// draw bg in white to be used for transparency
-		fl_rectf( 0, 0, W, h(), BlueBoxColor );
+		fl_rectf( 0, 0, W, logicalH(), BlueBoxColor );
 
 		// draw landscape
 		draw_landscape( 0, W );
@@ -4915,6 +5967,14 @@ bool FLTrator::create_terrain()
 		{
 			_demoData.clear();
 			_demoData.seed( seed );
+			if ( recordDemo() )
+			{
+				DemoFile::Header header;
+				header.seed = seed;
+				header.ship = _ship;
+				header.dx = DX;
+				demoJournal().start( demoFileName(), header );
+			}
 		}
 	}
 	DBG(  "seed #" << _level << ": " << seed );
@@ -4925,6 +5985,18 @@ bool FLTrator::create_terrain()
 	wavPath.level( _level );
 	imgPath.level( _level );
 
+	// pack all sprites of this level into one atlas image
+	// (again after FltImage::uncache())
+	string atlasId( asString( _level ) + "/" + asString( ship() ) );
+	if ( !FltImage::hasAtlas( atlasId ) )
+	{
+		vector<string> images;
+		for ( size_t i = 0; i < nbrOfItems( SPRITES ); i++ )
+			images.push_back( imgPath.get( SPRITES[i] ) );
+		images.push_back( imgPath.get( "spaceship" + asString( ship() ) + ".gif" ) );
+		FltImage::buildAtlas( images, atlasId );
+	}
+
 	string levelFile( _levelFile );
 	bool loaded( false );
 	errno = 0;
@@ -4933,7 +6005,7 @@ bool FLTrator::create_terrain()
 		// always create internal level, to keep random generator in sync
 		T.clear();
 		create_level();
-		loaded = (int)T.size() > w();
+		loaded = (int)T.size() > logicalW();
 	}
 	else if ( T.empty() )
 	{
@@ -4950,7 +6022,7 @@ bool FLTrator::create_terrain()
 			}
 		}
 	}
-	if ( (int)T.size() < w() )
+	if ( (int)T.size() < logicalW() )
 	{
 		string err( T.empty() && errno ? strerror( errno ) : "File is not a valid level file" );
 		PERR( "Failed to load level file " << levelFile << ": " << err );
@@ -4995,7 +6067,7 @@ bool FLTrator::create_terrain()
 		{
 			clear_level_image_cache();
 			// terrains with color change cannot be prebuild as image!
-			_terrain = T.hasColorChange() ? 0 : terrain_as_image();
+			_terrain = T.hasColorChange() || _endless ? 0 : terrain_as_image();
 			if ( _terrain && _gimmicks && _effects && !classic() )
 			{
 				_landscape = landscape_as_image();
@@ -5023,44 +6095,51 @@ bool FLTrator::create_terrain()
 		lastCachedClassic = classic();
 		TC = T;
 	}
-	TBG.clear();
+	Stars.clear();
+	Mountains.clear();
 	T.check();
-	if ( _effects )
+	if ( _effects && !_endless )	// (planes are built for the whole level)
 	{
 		// currently levels without sky draw mountains in background
+		size_t plane_size = T.size();
 		if ( !T.hasSky() )
 		{
-			int back = _final_xoff + w() / 2;
-			for ( int i = 0; i < back; i++ )
-				TBG.push_back( T[back - i - 1] );
-			TBG.flags = 1;	// use as marker for "has mountain plane"
+			// the plane scrolls with 1/3 speed, so only the part
+			// reachable until _final_xoff needs to be stored
+			int back = _final_xoff + logicalW() / 2;
+			int n = min( back, (int)( _final_xoff / 3 + 2 * SCREEN_W ) );
+			Mountains.reserve( n );
+			for ( int i = 0; i < n; i++ )
+				Mountains.push_back( T[back - i - 1].ground_level() * 2 / 3 );
+			plane_size = back;
 		}
 		// and levels with dark sky draw a starfield...
 		unsigned char r, g, b;
 		Fl::get_color( T.bg_color, r, g, b );
 		int n = ( r < 0x50 )+ ( g < 0x50 ) + ( b < 0x50 );
 		// ... but only if they have a dark or blue background color
-		if ( n > 2 || ( ( n >= 2 ) && b >= 0x50 ) )
+		if ( plane_size && ( n > 2 || ( ( n >= 2 ) && b >= 0x50 ) ) )
 		{
-			if ( TBG.empty() )
-			{
-				for ( size_t i = 0; i < T.size(); i++ )
-					TBG.push_back( TerrainPoint( 0, 0 ) );
-			}
-			else
-			{
-				for ( size_t i = 0; i < TBG.size(); i++ )
-					TBG[i].sky_level( 0 );
-			}
-			size_t n_stars = 1. / SCALE_X * TBG.size() / 10;
+			size_t n_stars = 1. / SCALE_X * plane_size / 10;
+			Stars.reserve( n_stars );
 			for ( size_t i = 0; i < n_stars; i++ )
 			{
-				int x = Random::pRand() % TBG.size();
-				int range = h() - 10;
+				int x = Random::pRand() % plane_size;
+				int range = logicalH() - 10;
 				int y = Random::pRand() % range + 5;
-				TBG[x].sky_level( y );	// store y in sky-level
+				Stars.push_back( Star( x, y ) );
+			}
+			// sort by x, a later star at the same x replaces the earlier one
+			stable_sort( Stars.begin(), Stars.end() );
+			size_t j = 0;
+			for ( size_t i = 0; i < Stars.size(); i++ )
+			{
+				if ( j && Stars[j - 1].x == Stars[i].x )
+					Stars[j - 1] = Stars[i];
+				else
+					Stars[j++] = Stars[i];
 			}
-			TBG.flags |= 2;	// use as marker for "has starfield plane"
+			Stars.erase( Stars.begin() + j, Stars.end() );
 		}
 	}
 
@@ -5117,147 +6196,129 @@ bool FLTrator::revert_level()
 	return false;
 }
 
-static void connectPoints( vector<Point> &terrain_, Terrain& T_, bool edgy_ )
+static void subdividePoints( const Point& p0_, const Point& p1_,
+                             vector<Point> &out_, bool edgy_ )
 //-------------------------------------------------------------------------------
 {
+	// Midpoint displacement of segment p0_/p1_, appends the inserted
+	// points and p1_ to out_ (left segment first, so the random numbers
+	// are used in the same order as by inserting the midpoints one by one).
 	static const int minDX = 20;	// 20
 	static const int minDY = 4;	// 4
 	static const int pertPerc = 8;	//	8
-	bool done( false );
-	while ( !done )
+	int dx = p1_.x - p0_.x;
+	int dy = p1_.y - p0_.y;
+	if ( dx < minDX || ( abs( dy ) < minDY && edgy_ ) )
 	{
-		done = true;
-		for ( size_t i = 0; i < terrain_.size() - 1; i++ )
-		{
-			int dx = terrain_[i + 1].x - terrain_[i].x;
-			if ( dx < minDX ) continue;
-			int dy = terrain_[i + 1].y - terrain_[i].y;
-			if ( abs( dy ) < minDY )
-			{
-				if ( edgy_ )
-					continue;
-				dy = minDY;
-			}
+		out_.push_back( p1_ );
+		return;
+	}
+	if ( abs( dy ) < minDY )
+		dy = minDY;
+	int mx = ( p0_.x + p1_.x ) / 2;
+	int my = p0_.y + ((double)dy / dx ) * ( mx - p0_.x );
 
-			done = false;
-			int mx = ( terrain_[i].x + terrain_[i + 1].x ) / 2;
-			int my = terrain_[i].y + ((double)dy / dx ) * ( mx - terrain_[i].x );
+	int pert = ceil( ( dx > abs( dy ) ? (double)dx : (double)( abs( dy )) ) / pertPerc );
+	int py = rangedRandom( -pert / 2 , pert );
+	my += py;
+	Point m( mx, my );
+	subdividePoints( p0_, m, out_, edgy_ );
+	subdividePoints( m, p1_, out_, edgy_ );
+}
 
-			int pert = ceil( ( dx > abs( dy ) ? (double)dx : (double)( abs( dy )) ) / pertPerc );
-			int py = rangedRandom( -pert / 2 , pert );
-			my += py;
-			terrain_.insert( terrain_.begin() + i + 1, Point( mx, my ) );
-			break;
-		}
-	}
+static void connectPoints( vector<Point> &terrain_, Terrain& T_, bool edgy_ )
+//-------------------------------------------------------------------------------
+{
+	// refine the points (linear in the number of resulting points)
+	static vector<Point> points;
+	points.clear();
+	if ( terrain_.size() )
+		points.push_back( terrain_[0] );
+	for ( size_t i = 0; i + 1 < terrain_.size(); i++ )
+		subdividePoints( terrain_[i], terrain_[i + 1], points, edgy_ );
+	terrain_.swap( points );
 
-	int x = 0;
-	int y = 0;
+	// set ground levels between the points
 	for ( size_t i = 0; i < terrain_.size(); i++ )
 	{
 		int xn = terrain_[i].x;
 		int yn = terrain_[i].y;
-		int dx = xn - x;
-		int dy = yn - y;
-		int xo = 0;
-		while ( x++ < xn )
+		if ( i )
 		{
-			int yy = dx ? y + ((double)dy / dx) * xo : y;
-			assert( x > 0 );
-			if ( x - 1 < (int)T_.size() )
-				T_[x - 1].ground_level( yy );
-			xo++;
+			int x = terrain_[i - 1].x;
+			int y = terrain_[i - 1].y;
+			int dx = xn - x;
+			int dy = yn - y;
+			for ( int xo = 0; x + xo < xn; xo++ )
+			{
+				int yy = y + ((double)dy / dx) * xo;
+				if ( x + xo >= 0 && x + xo < (int)T_.size() )
+					T_[x + xo].ground_level( yy );
+			}
 		}
-		assert( x > 0 );
-		if ( x - 1 < (int)T_.size() )
-			T_[x - 1].ground_level( yn );
-		x = xn;
-		y = yn;
+		if ( xn >= 0 && xn < (int)T_.size() )
+			T_[xn].ground_level( yn );
 	}
 }
 
-void FLTrator::create_level()
+//-------------------------------------------------------------------------------
+struct terrain_data
 //-------------------------------------------------------------------------------
 {
-	struct terrain_data
-	{
-		bool sky;
-		int edgy;
-		Fl_Color ground_color;
-		Fl_Color bg_color;
-		Fl_Color sky_color;
-		int outline_width;
-		Fl_Color outline_color_ground;
-		Fl_Color outline_color_sky;
-		int rockets;
-		int radars;
-		int drops;
-		int badies;
-		int cumulus;
-		int phasers;
-	};
-	static const struct terrain_data level_data[] = {
-		{ /*1*/false, 0, FL_GREEN, FL_BLUE, FL_GREEN, 0, FL_BLACK, FL_BLACK,
-			30, 20, 0, 0, 0, 0 },
-		{ /*2*/true, 0, fl_rgb_color( 241, 132, 0 ), fl_rgb_color( 97, 64, 41 ), fl_rgb_color( 139, 13, 6 ),
-		       3, FL_BLACK, FL_BLACK,
-			20, 20, 25, 0, 0, 0 },
-		{ /*3*/false, 0, FL_RED, FL_GRAY, FL_RED, 2, FL_WHITE, FL_WHITE,
-			30, 15, 0, 2, 0, 0 },
-		{ /*4*/true, 0, FL_DARK_GREEN, FL_CYAN, FL_DARK_YELLOW, 3, FL_BLACK, FL_YELLOW,
-			30, 10, 20, 1, 0, 0 },
-		{ /*5*/false, 2, FL_BLACK, FL_MAGENTA, FL_BLACK, 4, FL_RED, FL_RED,
-			35, 20, 0, 3, 0, 0 },
-		{ /*6*/false, 0, FL_DARK_RED, FL_DARK_GREEN, FL_DARK_RED, 0, FL_YELLOW, FL_YELLOW,
-			35, 20, 0, 2, 1, 0 },
-		{ /*7*/true, 1, FL_BLACK, FL_BLACK, FL_BLACK, 4, FL_GRAY, FL_CYAN,
-			20, 15, 20, 1, 0, 0 },
-		{ /*8*/false, 0, FL_WHITE, FL_DARK_BLUE, FL_WHITE, 4, FL_RED, FL_CYAN,
-			30, 20, 0, 4, 2, 0 },
-		{ /*9*/true, 0, FL_DARK_BLUE, FL_BLUE, FL_DARK_BLUE, 2, FL_CYAN, FL_CYAN,
-			30, 15, 20, 0, 1, 2 },
-		{ /*10*/true, 0, FL_BLACK, fl_lighter( FL_YELLOW ), FL_DARK_RED, 2, FL_BLACK, FL_WHITE,
-			30, 10, 20, 2, 2, 4 }
-	};
+	bool sky;
+	int edgy;
+	Fl_Color ground_color;
+	Fl_Color bg_color;
+	Fl_Color sky_color;
+	int outline_width;
+	Fl_Color outline_color_ground;
+	Fl_Color outline_color_sky;
+	int rockets;
+	int radars;
+	int drops;
+	int badies;
+	int cumulus;
+	int phasers;
+};
+
+static const struct terrain_data level_data[] = {
+	{ /*1*/false, 0, FL_GREEN, FL_BLUE, FL_GREEN, 0, FL_BLACK, FL_BLACK,
+		30, 20, 0, 0, 0, 0 },
+	{ /*2*/true, 0, fl_rgb_color( 241, 132, 0 ), fl_rgb_color( 97, 64, 41 ), fl_rgb_color( 139, 13, 6 ),
+	       3, FL_BLACK, FL_BLACK,
+		20, 20, 25, 0, 0, 0 },
+	{ /*3*/false, 0, FL_RED, FL_GRAY, FL_RED, 2, FL_WHITE, FL_WHITE,
+		30, 15, 0, 2, 0, 0 },
+	{ /*4*/true, 0, FL_DARK_GREEN, FL_CYAN, FL_DARK_YELLOW, 3, FL_BLACK, FL_YELLOW,
+		30, 10, 20, 1, 0, 0 },
+	{ /*5*/false, 2, FL_BLACK, FL_MAGENTA, FL_BLACK, 4, FL_RED, FL_RED,
+		35, 20, 0, 3, 0, 0 },
+	{ /*6*/false, 0, FL_DARK_RED, FL_DARK_GREEN, FL_DARK_RED, 0, FL_YELLOW, FL_YELLOW,
+		35, 20, 0, 2, 1, 0 },
+	{ /*7*/true, 1, FL_BLACK, FL_BLACK, FL_BLACK, 4, FL_GRAY, FL_CYAN,
+		20, 15, 20, 1, 0, 0 },
+	{ /*8*/false, 0, FL_WHITE, FL_DARK_BLUE, FL_WHITE, 4, FL_RED, FL_CYAN,
+		30, 20, 0, 4, 2, 0 },
+	{ /*9*/true, 0, FL_DARK_BLUE, FL_BLUE, FL_DARK_BLUE, 2, FL_CYAN, FL_CYAN,
+		30, 15, 20, 0, 1, 2 },
+	{ /*10*/true, 0, FL_BLACK, fl_lighter( FL_YELLOW ), FL_DARK_RED, 2, FL_BLACK, FL_WHITE,
+		30, 10, 20, 2, 2, 4 }
+};
 
+const terrain_data& FLTrator::levelData() const
+//-------------------------------------------------------------------------------
+{
 	assert( nbrOfItems( level_data ) >= MAX_LEVEL );
 	int set = ( _level - 1 ) % nbrOfItems( level_data );
-	const struct terrain_data& level = level_data[ set ];
-
-	T.ground_color = level.ground_color;
-	T.bg_color = level.bg_color;
-	T.sky_color = level.sky_color;
-	T.ls_outline_width = level.outline_width;
-	T.outline_color_ground = level.outline_color_ground;
-	T.outline_color_sky = level.outline_color_sky;
-
-	int rockets = level_data[ set ].rockets;
-	int radars = level_data[ set ].radars;
-	int drops = level_data[ set ].drops;
-	int badies = level_data[ set ].badies;
-	int cumulus = level_data[ set ].cumulus;
-	int phasers = level_data[ set ].phasers;
-	vector<Point> terrain;
-
-	//
-	// Generate ground
-	//
-	double hardestFactor = 0.7 + ((double)_level / MAX_LEVEL ) * 0.3;	// factor to make higher levels harder
-
-	int maxGround = ( h() * ( level.sky ? 3 : 4 ) ) / 5; // use 3/5 (with sky) or 4/5 ( w/o sky) of height
-	int minGround = h() / 20;	// minimum ground level
-
-	int bott = ( h() / 3 ) * hardestFactor;
-	int range = ceil( (double)maxGround * hardestFactor );
-
-	DBG( "range: " << range << " bott: " << bott << " hardestfactor: " << hardestFactor );
+	return level_data[ set ];
+}
 
-	static const size_t INTERNAL_TERRAIN_SIZE( 9 * SCREEN_W );
-	size_t X = 0;
-	int bott1 = minGround + bott / 2  + rangedRandom( -bott / 4, bott / 4 );
-	while ( X < INTERNAL_TERRAIN_SIZE )
-	{
-		/*
+bool FLTrator::create_ground( int limit_ )
+//-------------------------------------------------------------------------------
+{
+	// Add one 'hill' to the ground points. Returns false, if stopped
+	// because 'limit_' was reached.
+	/*
                           flat2
                          2)  3)
               peak       +---+
@@ -5270,70 +6331,75 @@ void FLTrator::create_level()
                      |   |
                     peak_dist1
 
-		*/
-		int flat1 = Random::Rand() % ( w() / 2 ) + w() / 8;
-		int r = ( X == 0 ) ? range / 2 : range;	// don't start with a high mountain
-		int peak = minGround + (( Random::Rand() % ( r / 2 )  + r / 2 ) * hardestFactor);
-		int peak_dist1 = ( Random::Rand() % ( peak * 2 ) ) + peak / 4;
-		int peak_dist2 = ( Random::Rand() % ( peak * 2 ) ) + peak / 4;
-		int flat2 = Random::Rand() % ( w() / 2 ) + ( !!level.edgy * w() / 5 );
-		if ( !level.edgy )
-		{
-			if ( Random::Rand() % 3 == 0 )
-				flat2 = Random::Rand() % 10;
-		}
-		int bott2 = minGround + bott + rangedRandom( -bott / 2, bott / 2 );
-		if ( bott2 > peak - 20 )
-			bott2 = peak - 20;
+	*/
+	const terrain_data& level = levelData();
+	LevelGenerator& g = _gen;
+	int flat1 = Random::Rand() % ( logicalW() / 2 ) + logicalW() / 8;
+	int r = ( g.X == 0 ) ? g.range / 2 : g.range;	// don't start with a high mountain
+	int peak = g.minGround + (( Random::Rand() % ( r / 2 )  + r / 2 ) * g.hardestFactor);
+	int peak_dist1 = ( Random::Rand() % ( peak * 2 ) ) + peak / 4;
+	int peak_dist2 = ( Random::Rand() % ( peak * 2 ) ) + peak / 4;
+	int flat2 = Random::Rand() % ( logicalW() / 2 ) + ( !!level.edgy * logicalW() / 5 );
+	if ( !level.edgy )
+	{
+		if ( Random::Rand() % 3 == 0 )
+			flat2 = Random::Rand() % 10;
+	}
+	int bott2 = g.minGround + g.bott + rangedRandom( -g.bott / 2, g.bott / 2 );
+	if ( bott2 > peak - 20 )
+		bott2 = peak - 20;
 
-		terrain.push_back( Point( X, bott1 ) );	// 0)
-		X += flat1;
-		terrain.push_back( Point( X, bott1 ) );	// 1)
+	g.points.push_back( Point( g.X, g.bott1 ) );	// 0)
+	g.X += flat1;
+	g.points.push_back( Point( g.X, g.bott1 ) );	// 1)
 
-		if ( X >= INTERNAL_TERRAIN_SIZE ) break;
+	if ( g.X >= limit_ ) return false;
 
-		X += level.edgy == 1 ? 1 : peak_dist1;
-		terrain.push_back( Point( X, peak ) );	// 2)
+	g.X += level.edgy == 1 ? 1 : peak_dist1;
+	g.points.push_back( Point( g.X, peak ) );	// 2)
 
-		if ( flat2 )
-		{
-			X += flat2;
-			terrain.push_back( Point( X, peak ) );	// 3)
-			if ( X >= INTERNAL_TERRAIN_SIZE ) break;
-		}
+	if ( flat2 )
+	{
+		g.X += flat2;
+		g.points.push_back( Point( g.X, peak ) );	// 3)
+		if ( g.X >= limit_ ) return false;
+	}
 
-		X += level.edgy == 1 ? 1 : peak_dist2;
-		terrain.push_back( Point( X, bott2 ) );	// 4)
+	g.X += level.edgy == 1 ? 1 : peak_dist2;
+	g.points.push_back( Point( g.X, bott2 ) );	// 4)
 
-		bott1 = bott2;
-	}
-	T.resize( terrain.back().x, TerrainPoint( 0 ) );
-	connectPoints( terrain, T, !!level.edgy );
+	g.bott1 = bott2;
+	return true;
+}
 
-	//
-	// Generate sky
-	//
-	if ( level.sky )
+void FLTrator::create_sky( size_t from_ )
+//-------------------------------------------------------------------------------
+{
+	if ( !levelData().sky )
+		return;
+	int top = logicalH() / 12;
+	for ( size_t i = from_; i < T.size(); i++ )
 	{
-		int top = h() / 12;
-		for ( size_t i = 0; i < T.size(); i++ )
+		int ground = T[i].ground_level();
+		int free = logicalH() - ground;
+		int sky = (int)( (double)top * (double)free / (double)logicalH() );
+		sky += _level * 5;
+		if ( logicalH() - ground - sky < _spaceship->h() + 20 )
+			sky = logicalH() - ground - _spaceship->h() - 20;
+		if ( sky  < -1 || sky >= logicalH() )
 		{
-			int ground = T[i].ground_level();
-			int free = h() - ground;
-			int sky = (int)( (double)top * (double)free / (double)h() );
-			sky += _level * 5;
-			if ( h() - ground - sky < _spaceship->h() + 20 )
-				sky = h() - ground - _spaceship->h() - 20;
-			if ( sky  < -1 || sky >= h() )
-			{
-				assert( sky  >= -1 && sky < h() );
-			}
-			T[i].sky_level( sky );
+			assert( sky  >= -1 && sky < logicalH() );
 		}
+		T[i].sky_level( sky );
 	}
-	//
-	// Setup object positions
-	//
+}
+
+void FLTrator::place_objects( int limit_ )
+//-------------------------------------------------------------------------------
+{
+	// create object at x within 'max_dist', at least at 'min_dist'
+	const terrain_data& level = levelData();
+	LevelGenerator& g = _gen;
 	int min_dist = 100 - _level * 5;
 	int max_dist = 200 - _level * 6;
 	if ( min_dist < _rocket.w() )
@@ -5341,19 +6407,18 @@ void FLTrator::create_level()
 	if ( max_dist < _rocket.w() * 3 )
 		max_dist = _rocket.w() * 3;
 
-	// create object at x within 'max_dist', at least at 'min_dist'
-	int last_x = Random::Rand() % max_dist + min_dist;
-	int o = 0;
-	int retry = 3;	// retries if no suitable place for object here
-	string objects;
-	while ( last_x < (int)T.size() )
+	if ( g.last_x < 0 )
+		g.last_x = Random::Rand() % max_dist + min_dist;
+	while ( g.last_x < limit_ )
 	{
-		if ( objects.empty() )
+		int last_x = g.last_x;
+		if ( g.objects.empty() )
 		{
 			// (re-)build shuffled object pool
-			objects = string( rockets, 'r' ) + string( radars, 'a' ) +
-				string( drops, 'd' ) + string( badies, 'b' ) +
-				string( cumulus, 'c' ) + string( phasers, 'p' );
+			string& objects = g.objects;
+			objects = string( level.rockets, 'r' ) + string( level.radars, 'a' ) +
+				string( level.drops, 'd' ) + string( level.badies, 'b' ) +
+				string( level.cumulus, 'c' ) + string( level.phasers, 'p' );
 			for ( size_t i = 0; i < objects.size() * 10; i++ )
 			{
 				objects.insert( objects.begin() + Random::Rand() % objects.size(), objects[0] );
@@ -5361,26 +6426,26 @@ void FLTrator::create_level()
 			}
 		}
 
-		int g = T[last_x].ground_level();
-		if ( h() - g > ( 100 - (int)_level * 10 ) )
+		int gl = T[last_x].ground_level();
+		if ( logicalH() - gl > ( 100 - (int)_level * 10 ) )
 		{
 			bool flat( true );
 			for ( int x = last_x -_rocket.w() / 2; x < last_x + _rocket.w() / 2; x++ )
 			{
-				if ( T[x].ground_level() > g + 3 || T[x].ground_level() < g - 3 )
+				if ( T[x].ground_level() > gl + 3 || T[x].ground_level() < gl - 3 )
 				{
 					flat = false;
 					break;
 				}
 			}
 			// pick an object if needed
-			if ( !o )
+			if ( !g.o )
 			{
-				int index = Random::Rand() % objects.size();
-				o = objects[ index ];
-				objects.erase( index, 1 );
+				int index = Random::Rand() % g.objects.size();
+				g.o = g.objects[ index ];
+				g.objects.erase( index, 1 );
 			}
-			switch ( o )
+			switch ( g.o )
 			{
 				case 'r':
 					if ( ( level.edgy && flat ) || !level.edgy )
@@ -5410,27 +6475,146 @@ void FLTrator::create_level()
 			//	too low for objects
 		}
 
-		if ( !T[last_x].object() && retry )
+		if ( !T[last_x].object() && g.retry )
 		{
 			//  object not set (not flat), try a little more right
-			last_x += 10;
-			retry--;
+			g.last_x += 10;
+			g.retry--;
 		}
 		else
 		{
-			if ( o == 'd' || !retry )
-				last_x += Random::Rand() % ( min_dist / 2 ) + _rocket.w();
+			if ( g.o == 'd' || !g.retry )
+				g.last_x += Random::Rand() % ( min_dist / 2 ) + _rocket.w();
 			else
-				last_x += Random::Rand() % max_dist + min_dist;
-			o = 0;
-			retry = 3;
+				g.last_x += Random::Rand() % max_dist + min_dist;
+			g.o = 0;
+			g.retry = 3;
 		}
 	}
+}
+
+void FLTrator::create_level()
+//-------------------------------------------------------------------------------
+{
+	const terrain_data& level = levelData();
+
+	T.ground_color = level.ground_color;
+	T.bg_color = level.bg_color;
+	T.sky_color = level.sky_color;
+	T.ls_outline_width = level.outline_width;
+	T.outline_color_ground = level.outline_color_ground;
+	T.outline_color_sky = level.outline_color_sky;
+
+	//
+	// Generate ground
+	//
+	LevelGenerator& g = _gen;
+	g.hardestFactor = 0.7 + ((double)_level / MAX_LEVEL ) * 0.3;	// factor to make higher levels harder
+
+	int maxGround = ( logicalH() * ( level.sky ? 3 : 4 ) ) / 5; // use 3/5 (with sky) or 4/5 ( w/o sky) of height
+	g.minGround = logicalH() / 20;	// minimum ground level
+
+	g.bott = ( logicalH() / 3 ) * g.hardestFactor;
+	g.range = ceil( (double)maxGround * g.hardestFactor );
+
+	DBG( "range: " << g.range << " bott: " << g.bott << " hardestfactor: " << g.hardestFactor );
+
+	g.X = 0;
+	g.bott1 = g.minGround + g.bott / 2  + rangedRandom( -g.bott / 4, g.bott / 4 );
+	g.points.clear();
+	g.last_x = -1;
+	g.o = 0;
+	g.retry = 3;	// retries if no suitable place for object here
+	g.objects.clear();
+
+	if ( _endless )
+	{
+		// only the start, the rest is created while playing (see stream_terrain())
+		// NOTE: never reverted, reverse mode is off (see reversLevel())
+		T.reserve( 8 * logicalW() );
+		extend_level( 2 * logicalW() );
+		int n = T.size();
+		addScrollinZone();
+		n = T.size() - n;
+		g.X += n;
+		g.last_x += n;
+		_final_xoff = INT_MAX / 2;
+		return;
+	}
+
+	static const int INTERNAL_TERRAIN_SIZE( 9 * SCREEN_W );
+	while ( g.X < INTERNAL_TERRAIN_SIZE && create_ground( INTERNAL_TERRAIN_SIZE ) )
+		;
+	T.resize( g.points.back().x, TerrainPoint( 0 ) );
+	connectPoints( g.points, T, !!level.edgy );
+
+	//
+	// Generate sky
+	//
+	create_sky( 0 );
+
+	//
+	// Setup object positions
+	//
+	place_objects( T.size() );
+
 	addScrollinZone();
 	revert_level();
 	addScrolloutZone();
 }
 
+void FLTrator::extend_level( int size_ )
+//-------------------------------------------------------------------------------
+{
+	// Endless mode: generate terrain up to column 'size_' (in whole hills),
+	// objects are placed as far as the terrain is complete around them.
+	LevelGenerator& g = _gen;
+	if ( g.X >= size_ )
+		return;
+	size_t from = T.size();
+	g.points.clear();
+	while ( g.X < size_ )
+		create_ground( INT_MAX );
+	T.resize( g.points.back().x, TerrainPoint( 0 ) );
+	connectPoints( g.points, T, !!levelData().edgy );
+	create_sky( from );
+	place_objects( T.size() - _rocket.w() );
+}
+
+void FLTrator::stream_terrain()
+//-------------------------------------------------------------------------------
+{
+	// Endless mode: T holds only a window of the terrain, from a screen
+	// behind _xoff to a few screens ahead. When the part ahead gets short,
+	// the columns left behind are dropped, all offsets are moved with the
+	// columns, and new terrain is added. So the memory use stays constant.
+	if ( (int)T.size() - _xoff >= 2 * logicalW() )
+		return;
+	AllocTrack::Allow allow;	// object pool
+	int drop = _xoff - logicalW();
+	if ( drop > 0 )
+	{
+		T.erase( T.begin(), T.begin() + drop );
+		if ( (int)_levelObjects.size() >= drop )
+			_levelObjects.erase( _levelObjects.begin(), _levelObjects.begin() + drop );
+		_xoff -= drop;
+		_draw_xoff -= drop;
+		_dxoff -= drop;
+		_gen.X -= drop;
+		_gen.last_x -= drop;
+	}
+	_snapshots.clear();	// they are for the old terrain window
+	extend_level( 4 * logicalW() );
+	T.first_check = true;	// update min/max levels
+
+	// objects of the new columns for restoreState()
+	int seen = _xoff + logicalW() + _cumulus.w() / 2;
+	_levelObjects.resize( T.size() );
+	for ( int x = seen; x < (int)T.size(); x++ )
+		_levelObjects[x] = T[x].object();
+	DBG( "stream_terrain: dropped " << drop << ", size " << T.size() );
+}
+
 void FLTrator::draw_badies() const
 //-------------------------------------------------------------------------------
 {
@@ -5542,26 +6726,35 @@ int FLTrator::drawText( int x_, int y_, const char *text_, size_t sz_, Fl_Color
 	va_end( argp );
 	flt_font( FL_HELVETICA_BOLD_ITALIC, sz_ );
 	Fl_Color cc = fl_contrast( FL_WHITE, c_ );
-	fl_color( cc );
+	int so = ceil( SCALE_Y * 2 );	// shadow offset
+	int n = strlen( buf );
+	const TextCache::Sprite *sprite = TextCache::get( buf, n, c_, cc, so );
+	int W = sprite ? sprite->width : (int)fl_width( buf );
 
 	if ( x_ != -1 )
 		x_ *= SCALE_X;
 	y_ *= SCALE_Y;
 	if ( y_ < 0 )
-		y_ = h() + y_;
+		y_ = logicalH() + y_;
 	if ( x_ < -1 ) // space between right edge and text end
-		x_ = w() - (int)fl_width( buf ) + x_;
+		x_ = logicalW() - W + x_;
 
 	int x = x_;
 	if ( x_ < 0 )
 	{
 		// centered
-		x = ( w() - (int)fl_width( buf ) ) / 2;
+		x = ( logicalW() - W ) / 2;
 	}
 
-	fl_draw( buf, strlen( buf ), x + ceil( SCALE_Y * 2 ), y_ + ceil( SCALE_Y * 2 ) );
-	fl_color( c_ );
-	fl_draw( buf, strlen( buf ), x, y_ );
+	if ( sprite )
+		sprite->draw( x, y_ );
+	else
+	{
+		fl_color( cc );
+		fl_draw( buf, n, x + so, y_ + so );
+		fl_color( c_ );
+		fl_draw( buf, n, x, y_ );
+	}
 	return lround( x / SCALE_X );
 }
 
@@ -5626,17 +6819,34 @@ int FLTrator::drawTable( int w_, int y_, const char *text_, size_t sz_, Fl_Color
 		*del++ = 0;
 		r = del;
 	}
-	fl_text_extents( l, xl, yl, wl, hl );
-	if ( r )
+	const TextCache::Sprite *ls = TextCache::get( l, strlen( l ), c_ );
+	const TextCache::Sprite *rs = r ? TextCache::get( r, strlen( r ), c_ ) : 0;
+	if ( ls )
+		wl = ls->ink_w;
+	else
+		fl_text_extents( l, xl, yl, wl, hl );
+	if ( rs )
+		wr = rs->ink_w;
+	else if ( r )
 		fl_text_extents( r, xr, yr, wr, hr );
 	if ( w_ <= 0 )	// just measure text
 		return lround( double( wl + wr ) / SCALE_X );
 
-	int x =  ( w() - w_ ) / 2;
+	int x =  ( logicalW() - w_ ) / 2;
 
-	fl_draw( l, strlen( l ), x + SCALE_Y * 2, y_ + SCALE_Y * 2 );
-	if ( r )
-		fl_draw( r, strlen( r ), x + w_ - wr + SCALE_Y * 2, y_ + SCALE_Y * 2 );
+	// NOTE: shadow and text are separate sprites, so the shadow 'dots'
+	//       are drawn over the shadow of the text (as with fl_draw())
+	int so = SCALE_Y * 2;	// shadow offset
+	const TextCache::Sprite *lss = ls ? TextCache::get( l, strlen( l ), cc ) : 0;
+	const TextCache::Sprite *rss = rs ? TextCache::get( r, strlen( r ), cc ) : 0;
+	if ( lss )
+		lss->draw( x + so, y_ + so );
+	else
+		fl_draw( l, strlen( l ), x + so, y_ + so );
+	if ( rss )
+		rss->draw( x + w_ - wr + so, y_ + so );
+	else if ( r )
+		fl_draw( r, strlen( r ), x + w_ - wr + so, y_ + so );
 
 	// draw 'dots'
 	static int DOT_SIZE = lround( SCALE_X * 5 );
@@ -5649,10 +6859,16 @@ int FLTrator::drawTable( int w_, int y_, const char *text_, size_t sz_, Fl_Color
 			fl_rectf( lx + SCALE_Y * 2 + i * DOT_SIZE * 2, y_ - SCALE_Y * 4, DOT_SIZE, DOT_SIZE );
 	}
 	fl_color( c_ );
-	fl_draw( l, strlen( l ), x, y_ );
+	if ( ls )
+		ls->draw( x, y_ );
+	else
+		fl_draw( l, strlen( l ), x, y_ );
 	if ( r )
 	{
-		fl_draw( r, strlen( r ), x + w_ - wr, y_ );
+		if ( rs )
+			rs->draw( x + w_ - wr, y_ );
+		else
+			fl_draw( r, strlen( r ), x + w_ - wr, y_ );
 		fl_color( fl_color_average( c_, cc, .8 ) );
 		for ( int i = 0; i < lw / ( DOT_SIZE * 2 ); i++ )
 			fl_rectf( lx + i * DOT_SIZE * 2, y_ - SCALE_Y * 5, DOT_SIZE, DOT_SIZE );
@@ -5702,7 +6918,7 @@ void FLTrator::draw_fadeout()
 {
 	if ( _dimmout || ( _effects > 1 && _state == PAUSED && !_done ) )
 	{
-		static int bytes = w() * h() * 4;
+		static int bytes = logicalW() * logicalH() * 4;
 		static uchar *screen = 0;
 		static Fl_RGB_Image *matte = 0;
 
@@ -5712,7 +6928,7 @@ void FLTrator::draw_fadeout()
 			memset( screen, 0, bytes );
 		}
 		if ( !matte )
-			matte = new Fl_RGB_Image( screen, w(), h(), 4 );
+			matte = new Fl_RGB_Image( screen, logicalW(), logicalH(), 4 );
 
 		unsigned alpha = 128; // default grayout value for paused mode
 		if ( !_dimmout )
@@ -5722,7 +6938,7 @@ void FLTrator::draw_fadeout()
 			// (important when run with speed correction)
 			static double fps = FPS;
 			if ( _alpha_matte < 10 )
-				fps = ( (double)w() / _DDX ) / 4;
+				fps = ( (double)logicalW() / _DDX ) / 4;
 			double total_frames = _TO * fps;
 			double perc = (double)_alpha_matte / total_frames;
 			alpha = perc * 256;
@@ -5758,14 +6974,14 @@ void FLTrator::draw_tvmask() const
 	static Fl_RGB_Image *tvmask = 0;
 	if ( !tvmask )
 	{
-		int bytes = w() * h() * d;
+		int bytes = logicalW() * logicalH() * d;
 		uchar *data = new uchar[ bytes ];
-		tvmask = new Fl_RGB_Image( data, w(), h(), d );
-		for ( int line = 0; line < h(); line++ )
+		tvmask = new Fl_RGB_Image( data, logicalW(), logicalH(), d );
+		for ( int line = 0; line < logicalH(); line++ )
 		{
-			for ( int col = 0; col < w(); col += tvmask_w )
+			for ( int col = 0; col < logicalW(); col += tvmask_w )
 			{
-				int n = min( tvmask_w, w() - col ) * d;
+				int n = min( tvmask_w, logicalW() - col ) * d;
 				memcpy( data, tvmask_data[line % tvmask_h], n );
 				data += n;
 			}
@@ -5783,15 +6999,15 @@ void FLTrator::draw_tv() const
 		static Fl_RGB_Image *scanlines = 0;
 		if ( !scanlines )
 		{
-			int bytes = w() * h() * d;
+			int bytes = logicalW() * logicalH() * d;
 			uchar *data = new uchar[ bytes ];
 			memset( data, 0, bytes );
-			scanlines = new Fl_RGB_Image( data, w(), h(), d );
+			scanlines = new Fl_RGB_Image( data, logicalW(), logicalH(), d );
 			int step = ceil( SCALE_Y * 2 );
 			if ( step < 2 )
 				step = 2;
-			for ( int y = 0; y < h(); y += step )
-				memset( &data[y * w() * 4], 0x20, w() * d ); // rgba=0x20202020
+			for ( int y = 0; y < logicalH(); y += step )
+				memset( &data[y * logicalW() * 4], 0x20, logicalW() * d ); // rgba=0x20202020
 		}
 		scanlines->draw( 0, 0 );
 	}
@@ -5831,7 +7047,13 @@ void FLTrator::draw_score()
 	if ( !sx )
 		flt_draw( buf, n, -15, -30, sx, sy ); // calc. coordionates
 	else	// to avoid costly fl_width() call
-		fl_draw( buf, n, sx, sy );
+	{
+		const TextCache::Sprite *sprite = TextCache::get( buf, n, fl_color() );
+		if ( sprite )
+			sprite->draw( sx, sy );
+		else
+			fl_draw( buf, n, sx, sy );
+	}
 
 	if ( !_effects )
 	{
@@ -5852,11 +7074,11 @@ void FLTrator::draw_score()
 		int lifes = MAX_LEVEL_REPEAT - _level_repeat;
 		if ( lifes )
 		{
-			_lifes[lifes - 1].draw( SCALE_X * 60, h() - SCALE_Y * 52 );
+			_lifes[lifes - 1].draw( SCALE_X * 60, logicalH() - SCALE_Y * 52 );
 		}
 		int proc = (int)( (float)_xoff / (float)( _final_xoff - _spaceship->x() ) * 100. );
-		int X = w() / 2 - SCALE_X * 16;
-		int Y = h() - SCALE_Y * 49;
+		int X = logicalW() / 2 - SCALE_X * 16;
+		int Y = logicalH() - SCALE_Y * 49;
 		int W = lround( SCALE_X * 100 );	// 100% = 100px
 		int H = SCALE_Y * 18;
 		fl_rect( X - 1, Y -1, W + 2, H + 2 );
@@ -5865,7 +7087,7 @@ void FLTrator::draw_score()
 		fl_rectf( X, Y, lround( proc * SCALE_X ), H );
 
 		if ( reversLevel() && !_completed )	// draw a down-arrow to denote going reverse levels
-			fl_draw_symbol( "@+22->", 0, h() - SCALE_Y * 45, SCALE_X * 20, SCALE_Y * 30, FL_RED );
+			fl_draw_symbol( "@+22->", 0, logicalH() - SCALE_Y * 45, SCALE_X * 20, SCALE_Y * 30, FL_RED );
 	}
 
 	if ( G_paused )
@@ -5874,7 +7096,7 @@ void FLTrator::draw_score()
 	}
 	else if ( _done )
 	{
-		if ( _level == _end_level && ( !_trainMode || _cheatMode ) )
+		if ( _level == _end_level && ( ( !_trainMode && !_autopilot ) || _cheatMode ) )
 		{
 			static bool revers_level = false;
 			string s;
@@ -5890,7 +7112,7 @@ void FLTrator::draw_score()
 					s = _texts.value( "mission_complete", 50, "** MISSION COMPLETE! **" );
 				else
 					s = _texts.value( "mission_part", 50, "** WELL DONE! **" );
-				(_anim_text = new AnimText( 0, SCALE_Y * 10, w(), s.c_str(),
+				(_anim_text = new AnimText( 0, SCALE_Y * 10, logicalW(), s.c_str(),
 					FL_WHITE, FL_RED, 50, 40, false, gimmicks() ))->start();
 
 				// add a "completed" bonus
@@ -5926,13 +7148,13 @@ void FLTrator::draw_score()
 			T.ground_color = fl_darker( FL_GRAY );
 
 			int r = 0;
-			int dx = w() / 10;
+			int dx = logicalW() / 10;
 			while ( Rockets.size() < 11 )
 			{
 				int x = Rockets.size() ? Rockets.back()->x() + dx : dx;
-				if ( x > w() - dx )
+				if ( x > logicalW() - dx )
 					x = dx;
-				int y = h() + r * 20 + _rocket.h();
+				int y = logicalH() + r * 20 + _rocket.h();
 				Rockets.push_back( new Rocket( x, y ) );
 				Rockets.back()->start();
 				r++;
@@ -5944,7 +7166,7 @@ void FLTrator::draw_score()
 			{
 				string s = _texts.value( "level_finished", 50,  "LEVEL %u FINISHED!" );
 				snprintf( buf, sizeof( buf ), s.c_str(), _level );
-				(_anim_level_finished = new AnimText( 0, SCALE_Y * 10, w(), buf,
+				(_anim_level_finished = new AnimText( 0, SCALE_Y * 10, logicalW(), buf,
 						FL_WHITE, FL_BLACK, 50, 30, false ))->start();
 			}
 			_anim_level_finished->draw();
@@ -5958,7 +7180,7 @@ void FLTrator::draw_score()
 		if ( !_anim_start_again )
 		{
 			string s = _texts.value( "start_again", 50, "START AGAIN!" );
-			(_anim_start_again = new AnimText( 0, SCALE_Y * 10, w(), s.c_str(),
+			(_anim_start_again = new AnimText( 0, SCALE_Y * 10, logicalW(), s.c_str(),
 					FL_RED, FL_WHITE, 50, 30, false ))->start();
 		}
 		if ( _level_repeat + 1 > MAX_LEVEL_REPEAT )
@@ -5971,7 +7193,7 @@ void FLTrator::draw_score()
 void FLTrator::draw_scores()
 //-------------------------------------------------------------------------------
 {
-	fl_rectf( 0, 0, w(), h(), 0x11111100 );
+	fl_rectf( 0, 0, logicalW(), logicalH(), 0x11111100 );
 	drawText( -1, 120, _texts.value( "congratulation", 20, "CONGRATULATION!" ),
 	          70, FL_RED );
 	drawText( -1, 200, _texts.value( "topped", 30, "You topped the hiscore:" ),
@@ -6043,17 +7265,17 @@ void FLTrator::draw_title()
 		static const Fl_Color c[] = { FL_GREEN, FL_BLUE, FL_YELLOW };
 		int ci = Random::pRand() % 3;
 		int stripe_h = SCALE_Y * 4;
-		for ( int y = 0; y < h(); y += stripe_h )
+		for ( int y = 0; y < logicalH(); y += stripe_h )
 		{
 			fl_color( c[ci] );
 			for ( int n = 0; n < stripe_h; n++ )
 			{
-				if ( y + n <= border_h || y + n >= h() - border_h )
-					fl_xyline( 0, y + n , w() );
+				if ( y + n <= border_h || y + n >= logicalH() - border_h )
+					fl_xyline( 0, y + n , logicalW() );
 				else
 				{
 					fl_xyline( 0, y + n, border_w );
-					fl_xyline( w() - border_w, y + n, w() );
+					fl_xyline( logicalW() - border_w, y + n, logicalW() );
 				}
 			}
 			ci++;
@@ -6063,8 +7285,8 @@ void FLTrator::draw_title()
 
 	if ( G_paused )
 	{
-		fl_rectf( 0, 0, w(), h(), fl_rgb_color( 0, 0, 0 ) );
-		reveal_height = h();
+		fl_rectf( 0, 0, logicalW(), logicalH(), fl_rgb_color( 0, 0, 0 ) );
+		reveal_height = logicalH();
 	}
 	else
 	{
@@ -6074,13 +7296,13 @@ void FLTrator::draw_title()
 		{
 			// gradient top/bottom 'title_color_beg' => 'title_color'
 			static Fl_Color title_color_beg = _ini.value( "title_color_beg", 0, 0xffffff, 0x808080 ) << 8;
-			grad_rect( border_w, border_h, w() - 2 * border_w, h() - dborder_h + 1, h(),
+			grad_rect( border_w, border_h, logicalW() - 2 * border_w, logicalH() - dborder_h + 1, logicalH(),
 			           false, title_color_beg, title_color );
 		}
 		else
 		{
 			// single color 'title_color'
-			fl_rectf( border_w, border_h, w() - 2 * border_w, h() - dborder_h + 1,
+			fl_rectf( border_w, border_h, logicalW() - 2 * border_w, logicalH() - dborder_h + 1,
 			          title_color << 8 );
 		}
 	}
@@ -6089,13 +7311,13 @@ void FLTrator::draw_title()
 #if FLTK_HAS_NEW_FUNCTIONS
 		Fl_Image::RGB_scaling( FL_RGB_SCALING_BILINEAR );
 #endif
-//		bgImage = _spaceship->origImage()->copy( w() - SCALE_X * 120, h() - SCALE_Y * 150 );
-		bgImage = fl_copy_image( _spaceship->origImage(),  w() - SCALE_X * 120, h() - SCALE_Y * 150 );
-//		bgImage2 = _rocket.origImage()->copy( w() / 3, h() - SCALE_Y * 150 );
-		bgImage2 = fl_copy_image( _rocket.origImage(), w() / 3, h() - SCALE_Y * 150 );
+//		bgImage = _spaceship->origImage()->copy( logicalW() - SCALE_X * 120, logicalH() - SCALE_Y * 150 );
+		bgImage = fl_copy_image( _spaceship->origImage(),  logicalW() - SCALE_X * 120, logicalH() - SCALE_Y * 150 );
+//		bgImage2 = _rocket.origImage()->copy( logicalW() / 3, logicalH() - SCALE_Y * 150 );
+		bgImage2 = fl_copy_image( _rocket.origImage(), logicalW() / 3, logicalH() - SCALE_Y * 150 );
 	}
 	if ( !title_anim )
-		(title_anim = new AnimText( 0, SCALE_Y * 20, w(), "FL'TRATOR",
+		(title_anim = new AnimText( 0, SCALE_Y * 20, logicalW(), "FL'TRATOR",
 		                            FL_RED, FL_WHITE, 90, 80, false,
 		                            gimmicks(), 2 ))->start();
 	if ( !G_paused )
@@ -6122,7 +7344,7 @@ void FLTrator::draw_title()
 	}
 	else
 	{
-		fl_push_clip( border_w, border_h, w() - 2 * border_w, h() - dborder_h );
+		fl_push_clip( border_w, border_h, logicalW() - 2 * border_w, logicalH() - dborder_h );
 		if ( _zoominShip && !_zoominShip->done() )
 			_zoominShip->draw();
 		else if ( bgImage )
@@ -6172,14 +7394,14 @@ void FLTrator::draw_title()
 		drawText( -1, -50, _texts.value( "paused_title", 20, "** PAUSED **" ), 40, FL_YELLOW );
 	else if ( _dimmout )
 	 {
-		reveal_height = h();
+		reveal_height = logicalH();
 		drawText( -1, -50, _texts.value( "get_ready", 20, "GET READY!" ), 40, FL_YELLOW );
 	}
 	else
 	{
 		static AnimText *space_to_start = 0;
 		if ( !space_to_start )
-			(space_to_start = new AnimText( 0, h() - 100 * SCALE_Y, w(),
+			(space_to_start = new AnimText( 0, logicalH() - 100 * SCALE_Y, logicalW(),
 				_texts.value( "space_to_start", 28, "** hit space to start **" ),
 			FL_YELLOW, FL_BLACK, 32, 26, false ))->start();
 		space_to_start->draw();
@@ -6199,9 +7421,9 @@ void FLTrator::draw_title()
 	if ( title_anim )
 		title_anim->draw();
 
-	if ( _gimmicks && reveal_height < h() - dborder_h )
+	if ( _gimmicks && reveal_height < logicalH() - dborder_h )
 	{
-		fl_rectf( border_w, border_h + reveal_height, w() - 2 * border_w, h() - reveal_height - border_h * 2, FL_BLACK );
+		fl_rectf( border_w, border_h + reveal_height, logicalW() - 2 * border_w, logicalH() - reveal_height - border_h * 2, FL_BLACK );
 		reveal_height += 6 * _DX;
 	}
 
@@ -6219,7 +7441,7 @@ void FLTrator::draw_shaded_background( int xoff_, int W_ )
 	T.check();
 	int sky_min = T.min_sky;
 	int ground_min = T.min_ground;
-	int H = h() - sky_min - ground_min + 1;
+	int H = logicalH() - sky_min - ground_min + 1;
 	assert( H > 0 );
 	int y = 0;
 	int W = W_;
@@ -6232,12 +7454,12 @@ void FLTrator::draw_shaded_background( int xoff_, int W_ )
 		{
 			while ( x < W &&
 			        ( T[xoff_ + x].sky_level() > y + sky_min ||
-			        h() - T[xoff_ + x].ground_level() < y + sky_min ) )
+			        logicalH() - T[xoff_ + x].ground_level() < y + sky_min ) )
 				x++;
 			int x0 = x;
 			while ( x < W &&
 			        ( T[xoff_ + x].sky_level() <= y + sky_min &&
-			        h() - T[xoff_ + x].ground_level() >= y + sky_min ) )
+			        logicalH() - T[xoff_ + x].ground_level() >= y + sky_min ) )
 				x++;
 			if ( x > x0 )
 				fl_xyline( x0, y + sky_min , x - 1 );
@@ -6300,7 +7522,7 @@ void FLTrator::draw_shaded_landscape( int xoff_, int W_ )
 				if ( T[xoff_ + X + i].ground_level() > G )
 					G = T[xoff_ + X + i].ground_level();
 			}
-			grad_rect( X, h() - G, D, G, g, true, c, T.ground_color );
+			grad_rect( X, logicalH() - G, D, G, g, true, c, T.ground_color );
 			W -= D;
 			X += D;
 		}
@@ -6310,7 +7532,7 @@ void FLTrator::draw_shaded_landscape( int xoff_, int W_ )
 	fl_color( T.bg_color );
 	for ( int i = 0; i < W_; i++ )
 	{
-		fl_yxline( i, T[xoff_ + i].sky_level(), h() - T[xoff_ + i].ground_level() );
+		fl_yxline( i, T[xoff_ + i].sky_level(), logicalH() - T[xoff_ + i].ground_level() );
 	}
 }
 
@@ -6364,7 +7586,7 @@ void FLTrator::draw_outline( int xoff_, int W_, int outline_width_,
 #endif
 	fl_begin_line();
 	for ( int i = 0; i < W_; i++ )
-		fl_vertex( i, h() - T[xoff_ + i].ground_level() );
+		fl_vertex( i, logicalH() - T[xoff_ + i].ground_level() );
 	fl_end_line();
 	fl_line_style( 0 );
 }
@@ -6414,7 +7636,7 @@ void FLTrator::draw_landscape( int xoff_, int W_ )
 			int g = T[xoff_ + x].ground_level();
 			while ( x < W_ && T[xoff_ + x + 1].ground_level() == g )
 				x++;
-			fl_rectf( xo, h() - g, x - xo + 1, g );
+			fl_rectf( xo, logicalH() - g, x - xo + 1, g );
 			x++;
 		}
 	}
@@ -6427,26 +7649,30 @@ bool FLTrator::draw_decoration()
 //-------------------------------------------------------------------------------
 {
 	bool redraw( false );
-	if ( TBG.flags & 2 )
+	if ( !Stars.empty() )
 	{
 		// test starfield
 		int xoff = _xoff / 4;	// scrollfactor 1/4
 		fl_color( FL_YELLOW );
-		for ( size_t x = 0; x < SCREEN_W; x++ )
-		{
-			if ( _xoff + x >= T.size() ) break;
-			int sy = TBG[xoff + x].sky_level();
+		static int sz = -1;
+		if ( sz < 0 )
+			sz = lround( SCALE_Y * 1 );
+		// only visit the stars within the visible range
+		vector<Star>::const_iterator it = lower_bound( Stars.begin(), Stars.end(), Star( xoff, 0 ) );
+		Random::Xoshiro128& rng = Random::Cosmetic();
+		for ( ; it != Stars.end() && it->x < xoff + (int)SCREEN_W; ++it )
+		{
+			int x = it->x - xoff;
+			if ( _xoff + x >= (int)T.size() ) break;
+			int sy = it->y;
 			if ( sy > T[_xoff + x].ground_level() &&
-			    h() - sy > T[_xoff + x].sky_level() )
+			    logicalH() - sy > T[_xoff + x].sky_level() )
 			{
-				static int sz = -1;
-				if ( sz < 0 )
-					sz = lround( SCALE_Y * 1 );
 				// draw with a "twinkle" effect
-				( Random::pRand() % 10 || G_paused ) ?
-					sz <= 1 ? fl_point( x, h() - sy ) :
-				   fl_pie( x - sz / 2, h() - sy - sz / 2, sz, sz, 0., 360. ) :
-				   fl_pie( x - sz, h() - sy - sz, sz * 2, sz * 2, 0., 360. );
+				( rng.below( 10 ) || G_paused ) ?
+					sz <= 1 ? fl_point( x, logicalH() - sy ) :
+				   fl_pie( x - sz / 2, logicalH() - sy - sz / 2, sz, sz, 0., 360. ) :
+				   fl_pie( x - sz, logicalH() - sy - sz, sz * 2, sz * 2, 0., 360. );
 			}
 		}
 		redraw = true;
@@ -6465,10 +7691,10 @@ bool FLTrator::draw_decoration()
 		{
 			// calc. a new random position for the deco object
 			deco_x = Random::pRand() % ( T.size() / 8 ) + T.size() / 16;
-			int H = h() - T.min_sky - T.min_ground + 1;
-			deco_y = Random::pRand() % ( H ? H / 2 : h() / 2 ) + H / 2 + T.min_ground / 3;
+			int H = logicalH() - T.min_sky - T.min_ground + 1;
+			deco_y = Random::pRand() % ( H ? H / 2 : logicalH() / 2 ) + H / 2 + T.min_ground / 3;
 		}
-		if ( deco.name().size() )
+		if ( deco.image() )
 		{
 			int xoff = _xoff / 4;	// scrollfactor 1/4
 			for ( int x = 0; x < (int)SCREEN_W + deco.w(); x++ )
@@ -6476,7 +7702,7 @@ bool FLTrator::draw_decoration()
 				if ( xoff + (int)x == deco_x )
 				{
 					deco.x( x - deco.w() );
-					deco.y( h() - deco_y - deco.h() / 2 );
+					deco.y( logicalH() - deco_y - deco.h() / 2 );
 					deco.draw();
 					redraw = true;
 					break;
@@ -6485,7 +7711,7 @@ bool FLTrator::draw_decoration()
 		}
 	}
 #endif
-	if ( TBG.flags & 1 && !classic() )
+	if ( !Mountains.empty() && !classic() )
 	{
 		// test for "parallax scrolling" background plane
 		int xoff = _xoff / 3;	// scrollfactor 1/3
@@ -6493,9 +7719,11 @@ bool FLTrator::draw_decoration()
 		for ( size_t i = 0; i < SCREEN_W; i++ )
 		{
 			if ( _xoff + i >= T.size() ) break;
+			size_t m = xoff + i + SCREEN_W;
+			if ( m >= Mountains.size() ) break;
 			// TODO: take account of outline_width if drawn (currently not)?
-			int g2 = h() - T[_xoff + i].ground_level()/* - T.ls_outline_width*/;
-			int g1 = h() - TBG[(xoff + i + SCREEN_W )].ground_level() * 2 / 3;
+			int g2 = logicalH() - T[_xoff + i].ground_level()/* - T.ls_outline_width*/;
+			int g1 = logicalH() - Mountains[m];
 			if ( g2 > g1 )
 				fl_yxline( i, g1 , g2 );
 		}
@@ -6511,8 +7739,146 @@ void FLTrator::draw()
 		return;
 	int xoff = _xoff;
 	_xoff = _draw_xoff;
-	do_draw();
+	if ( UPSCALE )
+		present();
+	else
+		do_draw();
 	_xoff = xoff;
+	if ( _autopilot && _state == LEVEL )
+		_pilot.drawn();
+
+	static bool first_title = true;
+	if ( first_title && _state == TITLE )
+	{
+		first_title = false;
+		Startup::mark( "first title frame" );
+		if ( STARTUP_TRACE )
+			Startup::report( cout );
+	}
+}
+
+void FLTrator::present()
+//-------------------------------------------------------------------------------
+{
+	// draw the game with logical screen size into the offscreen buffer...
+	if ( !_offscreen )
+		_offscreen = fl_create_offscreen( SCREEN_W, SCREEN_H );
+	fl_begin_offscreen( _offscreen );
+	do_draw();
+
+	// ... and scale it up to the window keeping the aspect ratio
+	// (nearest uses an integer factor if the window is large enough)
+	int W = w();
+	int H = h();
+	double f = min( (double)W / SCREEN_W, (double)H / SCREEN_H );
+	if ( UPSCALE == 1 && f >= 1. )
+		f = floor( f );
+	_present_w = lround( f * SCREEN_W );
+	_present_h = lround( f * SCREEN_H );
+	_present_x = ( W - _present_w ) / 2;
+	_present_y = ( H - _present_h ) / 2;
+	bool unscaled = _present_w == (int)SCREEN_W && _present_h == (int)SCREEN_H;
+#ifndef HAVE_SCALED_BLIT
+	if ( !unscaled )
+	{
+		// no way to scale the offscreen directly: fetch its pixels
+		_present_buf.resize( SCREEN_W * SCREEN_H * 3 );
+		fl_read_image( &_present_buf[0], 0, 0, SCREEN_W, SCREEN_H );
+	}
+#endif
+	fl_end_offscreen();
+
+	// black borders
+	fl_color( FL_BLACK );
+	if ( _present_x > 0 )
+	{
+		fl_rectf( 0, 0, _present_x, H );
+		fl_rectf( _present_x + _present_w, 0, W - _present_x - _present_w, H );
+	}
+	if ( _present_y > 0 )
+	{
+		fl_rectf( 0, 0, W, _present_y );
+		fl_rectf( 0, _present_y + _present_h, W, H - _present_y - _present_h );
+	}
+
+	if ( unscaled )
+	{
+		fl_copy_offscreen( _present_x, _present_y, SCREEN_W, SCREEN_H, _offscreen, 0, 0 );
+		return;
+	}
+
+#ifdef HAVE_SCALED_BLIT
+	// with FLTK 1.4 window and offscreen are in pixels of the screen scale
+	double s = 1.;
+#if FLTK_HAS_IMAGE_SCALING
+	s = Fl::screen_scale( screen_num() );
+#endif
+	int px = lround( s * _present_x );
+	int py = lround( s * _present_y );
+	int pw = lround( s * _present_w );
+	int ph = lround( s * _present_h );
+	int sw = lround( s * SCREEN_W );
+	int sh = lround( s * SCREEN_H );
+#endif
+#if defined(HAVE_SCALED_BLIT) && defined(WIN32)
+	HDC dc = fl_makeDC( _offscreen );
+	HGDIOBJ old = SelectObject( dc, _offscreen );
+	SetStretchBltMode( fl_gc, UPSCALE == 2 ? HALFTONE : COLORONCOLOR );
+	SetBrushOrgEx( fl_gc, 0, 0, NULL );	// required after setting HALFTONE
+	StretchBlt( fl_gc, px, py, pw, ph, dc, 0, 0, sw, sh, SRCCOPY );
+	SelectObject( dc, old );
+	DeleteDC( dc );
+#elif defined(HAVE_SCALED_BLIT)
+	XRenderPictFormat *format = XRenderFindVisualFormat( fl_display, fl_visual->visual );
+	Picture src = XRenderCreatePicture( fl_display, _offscreen, format, 0, 0 );
+	Picture dst = XRenderCreatePicture( fl_display, fl_window, format, 0, 0 );
+	XTransform xform = {{
+		{ XDoubleToFixed( (double)sw / pw ), 0, 0 },
+		{ 0, XDoubleToFixed( (double)sh / ph ), 0 },
+		{ 0, 0, XDoubleToFixed( 1 ) }
+	}};
+	XRenderSetPictureTransform( fl_display, src, &xform );
+	XRenderSetPictureFilter( fl_display, src, UPSCALE == 2 ? FilterBilinear : FilterNearest, 0, 0 );
+	XRenderComposite( fl_display, PictOpSrc, src, None, dst, 0, 0, 0, 0, px, py, pw, ph );
+	XRenderFreePicture( fl_display, src );
+	XRenderFreePicture( fl_display, dst );
+#elif FLTK_HAS_IMAGE_SCALING
+	// let the graphics driver do the scaling in one pass
+	if ( !_present_image )
+		_present_image = new Fl_RGB_Image( &_present_buf[0], SCREEN_W, SCREEN_H );
+	_present_image->uncache();	// pixels have changed
+	_present_image->scale( _present_w, _present_h, 0, 1 );
+	Fl_RGB_Scaling scaling = Fl_Image::scaling_algorithm();
+	Fl_Image::scaling_algorithm( UPSCALE == 2 ? FL_RGB_SCALING_BILINEAR : FL_RGB_SCALING_NEAREST );
+	_present_image->draw( _present_x, _present_y );
+	Fl_Image::scaling_algorithm( scaling );
+#else
+	// nearest neighbour scaling (bilinear is not supported with this FLTK version)
+	size_t rowsize = _present_w * 3;
+	_scaled_buf.resize( rowsize * _present_h );
+	uchar *d = &_scaled_buf[0];
+	int last_sy = -1;
+	for ( int y = 0; y < _present_h; y++, d += rowsize )
+	{
+		int sy = y * SCREEN_H / _present_h;
+		if ( sy == last_sy )
+		{
+			memcpy( d, d - rowsize, rowsize );	// same source row as before
+			continue;
+		}
+		last_sy = sy;
+		const uchar *src = &_present_buf[ sy * SCREEN_W * 3 ];
+		uchar *dst = d;
+		for ( int x = 0; x < _present_w; x++ )
+		{
+			const uchar *p = src + ( x * SCREEN_W / _present_w ) * 3;
+			*dst++ = *p++;
+			*dst++ = *p++;
+			*dst++ = *p;
+		}
+	}
+	fl_draw_image( &_scaled_buf[0], _present_x, _present_y, _present_w, _present_h );
+#endif
 }
 
 void FLTrator::do_draw()
@@ -6537,7 +7903,7 @@ void FLTrator::do_draw()
 	if ( _terrain )
 	{
 		// "blit" in pre-built image
-		fl_push_clip( 0, 0, w(), h() );
+		fl_push_clip( 0, 0, logicalW(), logicalH() );
 		_terrain->draw( -_xoff, 0 );
 		fl_pop_clip();
 	}
@@ -6565,10 +7931,10 @@ void FLTrator::do_draw()
 		}
 
 		// draw bg
-		fl_rectf( 0, 0, w(), h(), T.bg_color );
+		fl_rectf( 0, 0, logicalW(), logicalH(), T.bg_color );
 
 		// draw landscape
-		draw_landscape( _xoff, w() );
+		draw_landscape( _xoff, logicalW() );
 	}
 
 	draw_objects( true );	// objects for collision check
@@ -6583,7 +7949,7 @@ void FLTrator::do_draw()
 	if ( _landscape && _background )
 	{
 		// "blit" in pre-built images
-		fl_push_clip( 0, 0, w(), h() );
+		fl_push_clip( 0, 0, logicalW(), logicalH() );
 		_background->draw( -_xoff, 0 );
 		draw_decoration();
 		_landscape->draw( -_xoff, 0 );
@@ -6618,10 +7984,10 @@ void FLTrator::do_draw()
 	draw_score();
 
 	if ( G_paused )
-		reveal_width = w();
-	if ( _gimmicks && reveal_width < w() )
+		reveal_width = logicalW();
+	if ( _gimmicks && reveal_width < logicalW() )
 	{
-		fl_rectf( reveal_width, 0, w() - reveal_width, h(), FL_BLACK );
+		fl_rectf( reveal_width, 0, logicalW() - reveal_width, logicalH(), FL_BLACK );
 		reveal_width += 6 * _DX;
 	}
 
@@ -6914,6 +8280,7 @@ void FLTrator::create_explosion( int x_, int y_, Explosion::ExplosionType type_,
 {
 	if ( _gimmicks )
 	{
+		AllocTrack::Allow allow;
 		Explosions.push_back( new Explosion( x_, y_, type_, strength_, colors_, nColors_ ) );
 		Explosions.back()->start();
 	}
@@ -6923,7 +8290,7 @@ void FLTrator::create_spaceship()
 //-------------------------------------------------------------------------------
 {
 	delete _spaceship;
-	_spaceship = new Spaceship( w() / 2, 40, w(), h(), ship(),
+	_spaceship = new Spaceship( logicalW() / 2, 40, logicalW(), logicalH(), ship(),
 		_effects != 0 );	// before create_terrain()!
 	string shipId = "spaceship" + asString( ship() );
 	string id( shipId + ".bomb_x_offset" );
@@ -6934,6 +8301,15 @@ void FLTrator::create_spaceship()
 	id = shipId + ".missile_color";
 	long missile_color = _ini.value( id, 0, 0xffffff, 0xffffff );	// per level!
 	_spaceship->missileColor( (Fl_Color)( missile_color << 8 ) );
+
+	// build zoom frames of this ship in the background (for zoominShip()/zoomoutShip())
+	if ( _gimmicks )
+	{
+		ImageAnimation::Rect ship( _spaceship->x(), _spaceship->y(),
+		                           _spaceship->w(), _spaceship->h() );
+		ImageAnimation::prepare( _spaceship->flt_image(), ship, zoomRect(), zoomHQ() );
+		ImageAnimation::prepare( _spaceship->flt_image(), zoomRect(), ship, zoomHQ() );
+	}
 }
 
 void FLTrator::create_objects()
@@ -6945,14 +8321,15 @@ void FLTrator::create_objects()
 	static int wx = 0;
 	if ( !wx )
 		wx = _cumulus.w() / 2;	// assumption: cumulus is broadest object
-	for ( int i = (_xoff == 0 ? 0 : w() - _xdelta); i < w() + wx ; i++ )
+	for ( int i = (_xoff == 0 ? 0 : logicalW() - _xdelta); i < logicalW() + wx ; i++ )
 	{
 		if ( _xoff + i >= (int)T.size() ) break;
 		unsigned int o = T[_xoff + i].object();
 		if ( !o ) continue;
-		if ( o & O_ROCKET && i - _rocket.w() / 2 < w() )
+		AllocTrack::Allow allow;	// new objects
+		if ( o & O_ROCKET && i - _rocket.w() / 2 < logicalW() )
 		{
-			Rocket *r = new Rocket( i, h() - T[_xoff + i].ground_level() - _rocket.h() / 2 );
+			Rocket *r = new Rocket( i, logicalH() - T[_xoff + i].ground_level() - _rocket.h() / 2 );
 			int start_dist = _rocket_max_start_dist - _level * 20 -
 			                 Random::Rand() % _rocket_var_start_dist;
 			if ( start_dist < _rocket_min_start_dist )
@@ -6964,15 +8341,15 @@ void FLTrator::create_objects()
 			Rockets.push_back( r );
 			o &= ~O_ROCKET;
 		}
-		if ( o & O_RADAR && i - _radar.w() / 2 < w() )
+		if ( o & O_RADAR && i - _radar.w() / 2 < logicalW() )
 		{
-			Radar *r = new Radar( i, h() - T[_xoff + i].ground_level() - _radar.h() / 2 );
+			Radar *r = new Radar( i, logicalH() - T[_xoff + i].ground_level() - _radar.h() / 2 );
 			Radars.push_back( r );
 			o &= ~O_RADAR;
 		}
-		if ( o & O_PHASER && i - _phaser.w() / 2 < w())
+		if ( o & O_PHASER && i - _phaser.w() / 2 < logicalW())
 		{
-			Phaser *p = new Phaser( i, h() - T[_xoff + i].ground_level() - _phaser.h() / 2 );
+			Phaser *p = new Phaser( i, logicalH() - T[_xoff + i].ground_level() - _phaser.h() / 2 );
 			p->dxRange( _phaser_dx_range );
 			Phasers.push_back( p );
 			o &= ~O_PHASER;
@@ -6980,7 +8357,7 @@ void FLTrator::create_objects()
 			Phasers.back()->max_height( T[_xoff + i].sky_level() );
 			Phasers.back()->start();
 		}
-		if ( o & O_DROP && i - _drop.w() / 2 < w() )
+		if ( o & O_DROP && i - _drop.w() / 2 < logicalW() )
 		{
 			Drop *d = new Drop( i, T[_xoff + i].sky_level() + _drop.h() / 2 );
 			int start_dist = _drop_max_start_dist - _level * 20 -
@@ -6994,11 +8371,11 @@ void FLTrator::create_objects()
 			Drops.push_back( d );
 			o &= ~O_DROP;
 		}
-		if ( o & O_BADY && i - _bady.w() / 2 < w() )
+		if ( o & O_BADY && i - _bady.w() / 2 < logicalW() )
 		{
 			bool turn( Random::Rand() % 3 == 0 );
 			int X = turn ?
-			        h() - T[_xoff + i].ground_level() - _bady.h() / 2 :
+			        logicalH() - T[_xoff + i].ground_level() - _bady.h() / 2 :
 			        T[_xoff + i].sky_level() + _bady.h() / 2;
 			Bady *b = new Bady( i, X );
 			o &= ~O_BADY;
@@ -7008,11 +8385,11 @@ void FLTrator::create_objects()
 			b->dxRange( _bady_dx_range );
 			Badies.push_back( b );
 		}
-		if ( o & O_CUMULUS && i - _cumulus.w() / 2 < w() )
+		if ( o & O_CUMULUS && i - _cumulus.w() / 2 < logicalW() )
 		{
 			bool turn( Random::Rand() % 3 == 0 );
 			int X = turn ?
-			        h() - T[_xoff + i].ground_level() - _cumulus.h() / 2 :
+			        logicalH() - T[_xoff + i].ground_level() - _cumulus.h() / 2 :
 			        T[_xoff + i].sky_level() + _cumulus.h() / 2;
 			Cumulus *c = new Cumulus( i, X );
 			o &= ~O_CUMULUS;
@@ -7050,6 +8427,366 @@ void FLTrator::delete_objects()
 	Cumuluses.clear();
 }
 
+template <typename T>
+static void saveObjects( Snapshot& s_, const vector<T *>& objects_ )
+//-------------------------------------------------------------------------------
+{
+	s_ << (unsigned)objects_.size();
+	for ( size_t i = 0; i < objects_.size(); i++ )
+		objects_[i]->save( s_ );
+}
+
+template <typename T>
+static void restoreObjects( Snapshot& s_, vector<T *>& objects_ )
+//-------------------------------------------------------------------------------
+{
+	for ( size_t i = 0; i < objects_.size(); i++ )
+		delete objects_[i];
+	objects_.clear();
+	unsigned n;
+	s_ >> n;
+	for ( unsigned i = 0; i < n && s_.good(); i++ )
+	{
+		objects_.push_back( new T() );
+		objects_.back()->restore( s_ );
+	}
+}
+
+enum { SNAPSHOT_MAGIC = 0x53544c46 /* 'FLTS' */, SNAPSHOT_VERSION = 1 };
+
+void FLTrator::saveState( Snapshot& s_ ) const
+//-------------------------------------------------------------------------------
+{
+	// Only the object bits of the columns create_objects() has already
+	// seen can differ from the level start, and of these only the ones
+	// from _xoff on are still used.
+	int end = min( _xoff + logicalW() + _cumulus.w() / 2, (int)T.size() );
+	unsigned n = 0;
+	for ( int x = _xoff; x < end; x++ )
+		n += T[x].object() != 0;
+
+	uint32_t seed, seed2;
+	seed = Random::Seed( seed2 );
+	s_ << (uint32_t)SNAPSHOT_MAGIC << (uint32_t)SNAPSHOT_VERSION
+	   << _level << (unsigned)T.size()
+	   << seed << seed2
+	   << _xoff << _draw_xoff << _xdelta << _dxoff
+	   << _user.score << _bonus << _speed_right
+	   << T.bg_color << T.ground_color << T.sky_color
+	   << end << n;
+	for ( int x = _xoff; x < end; x++ )
+		if ( T[x].object() )
+			s_ << x << T[x].object();
+	s_ << (unsigned)_colorChangeList.size();
+	for ( size_t i = 0; i < _colorChangeList.size(); i++ )
+		s_ << _colorChangeList[i];
+
+	_spaceship->save( s_ );
+	saveObjects( s_, Missiles );
+	saveObjects( s_, Bombs );
+	saveObjects( s_, Rockets );
+	saveObjects( s_, Phasers );
+	saveObjects( s_, Radars );
+	saveObjects( s_, Drops );
+	saveObjects( s_, Badies );
+	saveObjects( s_, Cumuluses );
+	// NOTE: explosions are only decoration and not saved
+}
+
+bool FLTrator::restoreState( Snapshot& s_ )
+//-------------------------------------------------------------------------------
+{
+	uint32_t magic, version;
+	unsigned level, size;
+	s_.rewind();
+	s_ >> magic >> version >> level >> size;
+	if ( magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION ||
+	     level != _level || size != T.size() || !_spaceship )
+	{
+		PERR( "snapshot does not match level " << _level );
+		return false;
+	}
+
+	// columns seen by create_objects() since the snapshot get their
+	// objects back from the level start
+	int last_end = min( _xoff + logicalW() + _cumulus.w() / 2, (int)T.size() );
+
+	uint32_t seed, seed2;
+	int end;
+	unsigned n;
+	s_ >> seed >> seed2
+	   >> _xoff >> _draw_xoff >> _xdelta >> _dxoff
+	   >> _user.score >> _bonus >> _speed_right
+	   >> T.bg_color >> T.ground_color >> T.sky_color
+	   >> end >> n;
+	if ( _levelObjects.size() == T.size() )
+	{
+		for ( int x = end; x < last_end; x++ )
+			T[x].object( _levelObjects[x] );
+	}
+	for ( int x = _xoff; x < end; x++ )
+		T[x].object( 0 );
+	for ( unsigned i = 0; i < n; i++ )
+	{
+		int x;
+		unsigned o;
+		s_ >> x >> o;
+		if ( x >= _xoff && x < end )
+			T[x].object( o );
+	}
+	s_ >> n;
+	_colorChangeList.clear();
+	for ( unsigned i = 0; i < n && s_.good(); i++ )
+	{
+		int x;
+		s_ >> x;
+		_colorChangeList.push_back( x );
+	}
+
+	_spaceship->restore( s_ );
+	restoreObjects( s_, Missiles );
+	restoreObjects( s_, Bombs );
+	restoreObjects( s_, Rockets );
+	restoreObjects( s_, Phasers );
+	restoreObjects( s_, Radars );
+	restoreObjects( s_, Drops );
+	restoreObjects( s_, Badies );
+	restoreObjects( s_, Cumuluses );
+	for ( size_t i = 0; i < Explosions.size(); i++ )
+		delete Explosions[i];
+	Explosions.clear();
+
+	Fl::remove_timeout( cb_bomb_unlock, this );
+	_bomb_lock = false;
+
+	// last, as creating objects may use random numbers
+	Random::Srand( seed, seed2 );
+
+	if ( !s_.good() )
+		PERR( "snapshot is corrupt" );
+	return s_.good();
+}
+
+void FLTrator::checkpoint()
+//-------------------------------------------------------------------------------
+{
+	// Checkpoints are taken in practice mode and in demos only, at the
+	// start of a frame, about every 2 seconds.
+	if ( !( _state == DEMO || ( _state == LEVEL && _trainMode ) ) ||
+	     _done || _collision || !_spaceship )
+		return;
+	if ( !_snapshots.empty() && _xoff - _snapshots.pos() < logicalW() / 2 )
+		return;
+	AllocTrack::Allow allow;	// until the ring slots have grown
+	saveState( _snapshots.push( _xoff ) );
+}
+
+bool FLTrator::rewind( int minDist_ )
+//-------------------------------------------------------------------------------
+{
+	// go back to the newest checkpoint at least 'minDist_' pixels back
+	// (or to the oldest one)
+	while ( _snapshots.size() > 1 && _xoff - _snapshots.pos() < minDist_ )
+		_snapshots.pop();
+	if ( _snapshots.empty() )
+		return false;
+	AllocTrack::Allow allow;	// recreates objects
+	if ( !restoreState( _snapshots.back() ) )
+	{
+		_snapshots.clear();
+		return false;
+	}
+	DBG( "rewind to " << _xoff );
+	if ( !REDRAWS ) redraw();
+	return true;
+}
+
+bool FLTrator::retryFromCheckpoint()
+//-------------------------------------------------------------------------------
+{
+	// continue at a checkpoint at least 1 second before the collision
+	if ( !rewind( logicalW() / 4 ) )
+		return false;
+	_level_repeat++;
+	_collision = false;
+	_left = _right = _up = _down = false;
+	delete _anim_start_again;
+	_anim_start_again = 0;
+	if ( Fl::focus() == this || _autopilot )
+		setPaused( false );
+	startBgSound();
+	return true;
+}
+
+int FLTrator::bombDistance( int height_ ) const
+//-------------------------------------------------------------------------------
+{
+	// horizontal distance (in terrain) a bomb travels while falling 'height_'
+	// (follows Bomb::update(), while the terrain scrolls on)
+	double scroll = _DDX * 0.05 / FRAMES;
+	int dy = lround( SCALE_Y * 10 );
+	unsigned speed = _speed_right;
+	double x = 0.;
+	int y = 0;
+	for ( unsigned state = 1; y < height_ && state < 100; state++ )
+	{
+		y += dy;
+		if ( state < 5 )
+			x += lround( SCALE_X * 16 );
+		else if ( state > 15 )
+			x -= lround( SCALE_X * 5 );
+		x -= lround( SCALE_X * 3 );
+		x -= lround( SCALE_X * ( speed / 30 ) );
+		if ( state % 2 )
+			dy += lround( SCALE_Y * 1 );
+		speed /= 2;
+		x += scroll;
+	}
+	return lround( x );
+}
+
+void FLTrator::autopilot()
+//-------------------------------------------------------------------------------
+{
+	_pilot.frame();
+	Autopilot::World& world = _pilot_world;
+	const Spaceship& ship = *_spaceship;
+	double updates = FRAMES / 0.05;	// object updates per frame
+
+	// free space ahead (the vectors grow once, only the first frames allocate)
+	int W = logicalW() + 6 * ship.w();
+	size_t n = Rockets.size() + Radars.size() + Drops.size() + Badies.size() + 2 * Phasers.size();
+	if ( world.top.capacity() < (size_t)W || world.obstacles.capacity() < n )
+	{
+		AllocTrack::Allow allow;
+		world.top.reserve( W );
+		world.bottom.reserve( W );
+		world.obstacles.reserve( 2 * n );
+	}
+	world.top.resize( W );
+	world.bottom.resize( W );
+	for ( int x = 0; x < W; x++ )
+	{
+		size_t i = _xoff + x;
+		world.top[x] = i < T.size() ? T[i].sky_level() : 0;
+		world.bottom[x] = i < T.size() ? logicalH() - T[i].ground_level() : logicalH();
+	}
+
+	// obstacles
+	world.obstacles.clear();
+	for ( size_t i = 0; i < Rockets.size(); i++ )
+	{
+		const Rocket& r = *Rockets[i];
+		if ( r.exploding() || r.exploded() )
+			continue;
+		double vy = 0.;
+		if ( r.lifted() )
+			vy = -ceil( SCALE_Y * min( 12u, ( 1 + r.state() / 10 ) * r.speed() ) ) * updates;
+		world.obstacles.push_back( Autopilot::Box( r.x(), r.y(), r.w(), r.h(), vy ) );
+	}
+	for ( size_t i = 0; i < Radars.size(); i++ )
+	{
+		const Radar& r = *Radars[i];
+		if ( !r.exploding() && !r.exploded() )
+			world.obstacles.push_back( Autopilot::Box( r.x(), r.y(), r.w(), r.h() ) );
+	}
+	for ( size_t i = 0; i < Drops.size(); i++ )
+	{
+		const Drop& d = *Drops[i];
+		double vy = 0.;
+		if ( d.dropped() )
+			vy = ceil( SCALE_Y * min( 12u, ( 1 + d.state() / 10 ) * d.speed() ) ) * updates;
+		world.obstacles.push_back( Autopilot::Box( d.x(), d.y(), d.w(), d.h(), vy ) );
+	}
+	for ( size_t i = 0; i < Badies.size(); i++ )
+	{
+		const Bady& b = *Badies[i];
+		double vy = ceil( SCALE_Y * min( 12u, b.speed() ) ) * updates;
+		world.obstacles.push_back( Autopilot::Box( b.x(), b.y(), b.w(), b.h(),
+		                                           b.turned() ? -vy : vy ) );
+	}
+	for ( size_t i = 0; i < Phasers.size(); i++ )
+	{
+		const Phaser& p = *Phasers[i];
+		if ( p.exploding() || p.exploded() )
+			continue;
+		world.obstacles.push_back( Autopilot::Box( p.x(), p.y(), p.w(), p.h() ) );
+		// beam, when the phaser fires (see Phaser::draw())
+		int bw = lround( SCALE_Y * 3 );
+		int top = max( 0, T[ max( 0, _xoff + p.cx() ) ].sky_level() );
+		Autopilot::Box beam( p.cx() - bw, top, 2 * bw, p.y() - top );
+		beam.period = 40;
+		beam.on = 36;
+		beam.phase = p.state() % 40;
+		beam.rate = updates;
+		world.obstacles.push_back( beam );
+	}
+
+	world.sx = ship.x();
+	world.sy = ship.y();
+	world.sw = ship.w();
+	world.sh = ship.h();
+	world.dx = _DDX;
+	world.dy = _DDX * _YF;
+	world.xmin = _xoff + ship.cx() < _final_xoff - logicalW() / 2 ? 0 : ship.x();	// no retreat at end
+	world.xmax = logicalW() / 2;
+	world.ymin = 0;
+	world.ymax = logicalH() - ship.h();
+
+	int move = _pilot.plan( world );
+	_up = move == Autopilot::UP;
+	_down = move == Autopilot::DOWN;
+	// move left/right as planned, otherwise return to start position
+	_left = _pilot.horizontal() == Autopilot::LEFT;
+	_right = _pilot.horizontal() == Autopilot::RIGHT ||
+	         ( !_left && _pilot.margin() > ship.h() / 4 && ship.x() < _autopilot_home );
+
+	// fire at everything in missile range
+	int mx = ship.x() + ship.missilePoint().x + 20;
+	int my = ship.y() + ship.missilePoint().y;
+	int range = lround( SCALE_X * 450 );
+	for ( size_t i = 0; i < world.obstacles.size(); i++ )
+	{
+		const Autopilot::Box& o = world.obstacles[i];
+		if ( o.period || o.x + o.w < mx || o.x > mx + range ||
+		     my < o.y || my > o.y + o.h )
+			continue;
+		fireMissile();
+		break;
+	}
+
+	// bomb ground targets, when a bomb would hit them
+	if ( !_bomb_lock )
+	{
+		int bx = ship.x() + ship.bombPoint().x;
+		int by = ship.y() + ship.bombPoint().y + ship.bombXOffset();
+		for ( size_t i = 0; i < world.obstacles.size(); i++ )
+		{
+			const Autopilot::Box& o = world.obstacles[i];
+			if ( o.period || o.vy || o.y <= by )
+				continue;
+			int x = bx + bombDistance( o.y - by );
+			if ( x >= o.x && x < o.x + o.w )
+			{
+				dropBomb();
+				break;
+			}
+		}
+	}
+}
+
+void FLTrator::autopilotLevelEnd()
+//-------------------------------------------------------------------------------
+{
+	bool done = _state == LEVEL_DONE;
+	double progress = (double)( _xoff + _spaceship->x() ) / _final_xoff;
+	_pilot.levelEnd( Startup::now(), done, progress );
+	cout << "autopilot: level " << _level << ( done ? " done" : " failed" )
+	     << " at " << lround( progress * 100 ) << "%" << endl;
+	if ( _autopilot_levels && _pilot.stats().levels >= _autopilot_levels )
+		hide();
+}
+
 void FLTrator::update_badies()
 //-------------------------------------------------------------------------------
 {
@@ -7060,7 +8797,7 @@ void FLTrator::update_badies()
 			badie.x( badie.x() - _xdelta );
 
 		int top = T[_xoff + badie.x() + badie.w() / 2].sky_level();
-		int bottom = h() - T[_xoff + badie.x() + badie.w() / 2].ground_level();
+		int bottom = logicalH() - T[_xoff + badie.x() + badie.w() / 2].ground_level();
 		bool gone = badie.x() < -badie.w();
 		if ( gone )
 		{
@@ -7093,8 +8830,8 @@ void FLTrator::update_bombs()
 	for ( size_t i = 0; i < Bombs.size(); i++ )
 	{
 		Bomb& bomb = *Bombs[i];
-		bool gone = bomb.y() > h() ||
-		            bomb.y() + bomb.h() > h() - T[_xoff + bomb.x()].ground_level();
+		bool gone = bomb.y() > logicalH() ||
+		            bomb.y() + bomb.h() > logicalH() - T[_xoff + bomb.x()].ground_level();
 		if ( gone )
 		{
 			Bomb *b = Bombs[i];
@@ -7115,7 +8852,7 @@ void FLTrator::update_cumuluses()
 			cumulus.x( cumulus.x() - _xdelta );
 
 		int top = T[_xoff + cumulus.x() + cumulus.w() / 2].sky_level();
-		int bottom = h() - T[_xoff + cumulus.x() + cumulus.w() / 2].ground_level();
+		int bottom = logicalH() - T[_xoff + cumulus.x() + cumulus.w() / 2].ground_level();
 		bool gone = cumulus.x() < -cumulus.w();
 		if ( gone )
 		{
@@ -7151,7 +8888,7 @@ void FLTrator::update_drops()
 		if ( !paused() )
 			drop.x( drop.x() - _xdelta );
 
-		int bottom = h() - T[_xoff + drop.x()].ground_level();
+		int bottom = logicalH() - T[_xoff + drop.x()].ground_level();
 		if ( 0 == bottom ) bottom += drop.h();	// glide out completely if no ground
 		bool gone = drop.y() + drop.h() / 2 > bottom || drop.x() < -drop.w();
 		if ( gone )
@@ -7218,8 +8955,8 @@ void FLTrator::update_missiles()
 	{
 		Missile& missile = *Missiles[i];
 		bool gone = missile.exhausted() ||
-		            missile.x() > w() ||
-		            missile.y() > h() - T[_xoff + missile.x() + missile.w()].ground_level() ||
+		            missile.x() > logicalW() ||
+		            missile.y() > logicalH() - T[_xoff + missile.x() + missile.w()].ground_level() ||
 		            missile.y() < T[_xoff + missile.x() + missile.w()].sky_level();
 		if ( gone )
 		{
@@ -7366,9 +9103,13 @@ void FLTrator::setIcon()
 		Fl_Window::default_icon( (Fl_RGB_Image *)_spaceship->origImage() );
 	else
 	{
-		Fl_GIF_Image defIcon( imgPath.get( "spaceship0.gif" ).c_str() );
-		Fl_RGB_Image rgbDefIcon( &defIcon );
-		Fl_Window::default_icon( &rgbDefIcon);
+		// NOTE: shared image (preloaded by startup task) is also used for the ship
+		Fl_Shared_Image *defIcon = getSharedImage( imgPath.get( "spaceship0.gif" ).c_str() );
+		if ( defIcon )
+		{
+			Fl_RGB_Image rgbDefIcon( (Fl_Pixmap *)defIcon );
+			Fl_Window::default_icon( &rgbDefIcon);
+		}
 	}
 #endif
 }
@@ -7452,27 +9193,35 @@ void FLTrator::setBgSoundFile( const string &name_/* = "bgsound"*/,
 		else if ( pick_random_ )
 		{
 			// pick a random bg sound from folder 'bgsound'
-			dirent **ls;
-			Fl_File_Sort_F *sort = fl_casealphasort;
-			string bgdir( mkPath( "bgsound" ) );
-			int num_files = fl_filename_list( bgdir.c_str(), &ls, sort );
-			vector<string> bgSoundList;
-			for ( int i = 0; i < num_files; i++ )
+			// (folder is scanned only once, when first needed)
+			static vector<string> bgSoundFiles;
+			static bool scanned = false;
+			if ( !scanned )
 			{
+				scanned = true;
+				dirent **ls;
+				Fl_File_Sort_F *sort = fl_casealphasort;
+				string bgdir( mkPath( "bgsound" ) );
+				int num_files = fl_filename_list( bgdir.c_str(), &ls, sort );
 				string pattern = "*." + Audio::instance()->ext();
-				if ( fl_filename_match( ls[i]->d_name, pattern.c_str() ) )
+				for ( int i = 0; i < num_files; i++ )
 				{
-					bgSoundList.push_back( bgdir + ls[i]->d_name );
+					if ( fl_filename_match( ls[i]->d_name, pattern.c_str() ) )
+					{
+						bgSoundFiles.push_back( bgdir + ls[i]->d_name );
+					}
 				}
+				fl_filename_free_list( &ls, num_files );
 			}
-			fl_filename_free_list( &ls, num_files );
+			const vector<string>& bgSoundList( bgSoundFiles );
 			if ( bgSoundList.size() )
 			{
-				size_t picked = Random::pRand() % bgSoundList.size();
-				if ( bgSoundList[ picked ] == _bgsound && bgSoundList.size() > 1 )
+				size_t n = bgSoundList.size();
+				size_t picked = Random::pRand() % n;
+				if ( bgSoundList[ picked ] == _bgsound && n > 1 )
 				{
-					bgSoundList.erase( bgSoundList.begin() + picked );
-					picked = Random::pRand() % bgSoundList.size();
+					// pick one of the others
+					picked = ( picked + 1 + Random::pRand() % ( n - 1 ) ) % n;
 				}
 				_bgsound = bgSoundList[ picked ];
 			}
@@ -7564,6 +9313,18 @@ bool FLTrator::setFullscreen( bool fullscreen_ )
 #endif
 	bool isFull = fullscreen_active();
 
+	if ( UPSCALE )
+	{
+		// any window size can be presented, so the screen resolution stays
+		if ( fullscreen_ && !isFull )
+			fullscreen();
+		else if ( !fullscreen_ && isFull )
+			fullscreen_off();
+		size_range( MIN_SCREEN_W, MIN_SCREEN_W * SCREEN_H / SCREEN_W, 0, 0 ); // enable resizable
+		show();
+		return fullscreen_active();
+	}
+
 	if ( fullscreen_ )
 	{
 		// switch to fullscreen
@@ -7753,6 +9514,7 @@ bool FLTrator::dropBomb()
 {
 	if ( !_bomb_lock && !paused() && Bombs.size() < 5 )
 	{
+		AllocTrack::Allow allow;
 		Bomb *b = new Bomb( _spaceship->x() + _spaceship->bombPoint().x,
 		                    _spaceship->y() + _spaceship->bombPoint().y +
 		                    _spaceship->bombXOffset() );
@@ -7772,6 +9534,7 @@ bool FLTrator::fireMissile()
 {
 	if ( Missiles.size() < 5 && !paused() )
 	{
+		AllocTrack::Allow allow;
 		Missile *m = new Missile( _spaceship->x() + _spaceship->missilePoint().x + 20,
 		                          _spaceship->y() + _spaceship->missilePoint().y,
 		                          _spaceship->missileColor() );
@@ -7983,6 +9746,11 @@ void FLTrator::onNextScreen( bool fromBegin_/* = false*/ )
 //-------------------------------------------------------------------------------
 {
 	DBG( "onNextScreen(" << fromBegin_ << ") " << _first_level );
+	if ( !fromBegin_ && _state == LEVEL && _trainMode && _collision && !_done &&
+	     _level_repeat < MAX_LEVEL_REPEAT && retryFromCheckpoint() )
+		return;
+	_snapshots.clear();
+
 	delete _spaceship;
 	_spaceship = 0;
 	delete _anim_text;
@@ -8009,9 +9777,11 @@ void FLTrator::onNextScreen( bool fromBegin_/* = false*/ )
 	bool show_scores = false;
 	if ( _state == LEVEL )
 	{
-		if ( _demoData.size() && (int)_demoData.size() >= _final_xoff - w() / 2 &&
-		     !_trainMode && !_no_demo )
+		if ( _demoData.size() && (int)_demoData.size() >= _final_xoff - logicalW() / 2 &&
+		     recordDemo() )
 			saveDemoData();
+		else
+			demoJournal().discard();
 		_demoData.clear();
 	}
 
@@ -8067,6 +9837,7 @@ void FLTrator::onNextScreen( bool fromBegin_/* = false*/ )
 				_bonus = 0;
 
 				show_scores &= _level == _first_level && _level_repeat == 0; // ??? alwaws true
+				show_scores &= !_autopilot;
 				if ( show_scores )
 				{
 					_input = _user.name == DEFAULT_USER ? "" : _user.name;
@@ -8102,13 +9873,18 @@ void FLTrator::onNextScreen( bool fromBegin_/* = false*/ )
 		if ( T[ i ].object() & O_COLOR_CHANGE )
 			_colorChangeList.push_back( i );
 
+	// keep objects of level start for restoreState()
+	_levelObjects.resize( T.size() );
+	for ( size_t i = 0; i < T.size(); i++ )
+		_levelObjects[i] = T[i].object();
+
 	if ( _state == DEMO )
 	{
-		if ( _demoData.size() && (int)_demoData.size() < _final_xoff - w() / 2 )
+		if ( _demoData.size() && (int)_demoData.size() < _final_xoff - logicalW() / 2 )
 		{
 			// clear incomplete demo data
 			PERR( "demo " << demoFileName() << " is corrupt" <<
-			      " (" << _demoData.size() << "<" << _final_xoff - w() / 2 << ")" );
+			      " (" << _demoData.size() << "<" << _final_xoff - logicalW() / 2 << ")" );
 			_demoData.clear();
 		}
 
@@ -8122,7 +9898,7 @@ void FLTrator::onNextScreen( bool fromBegin_/* = false*/ )
 
 	if ( !_level_repeat )
 	{
-		(_anim_text = new AnimText( 0, SCALE_Y * 20, w(), _level_name.c_str() ))->start();
+		(_anim_text = new AnimText( 0, SCALE_Y * 20, logicalW(), _level_name.c_str() ))->start();
 		if ( _state == LEVEL )
 		{
 			setBgSoundFile();
@@ -8131,7 +9907,7 @@ void FLTrator::onNextScreen( bool fromBegin_/* = false*/ )
 	// start ship animation titlescreen->playscreen effect
 	zoomoutShip();
 
-	if ( Fl::focus() == this )
+	if ( Fl::focus() == this || _autopilot )
 		setPaused( false );
 
 	if ( _state == LEVEL )
@@ -8155,19 +9931,18 @@ bool FLTrator::zoominShip( bool updateOrigin_ )
 			return false;
 
 	// start new animation
-	int x_origin = _zoominShip ? Random::pRand() % w() : _spaceship->x();
-	int y_origin = _zoominShip ? Random::pRand() % h() / 2 + h() / 2 : _spaceship->y();
+	int x_origin = _zoominShip ? Random::pRand() % logicalW() : _spaceship->x();
+	int y_origin = _zoominShip ? Random::pRand() % logicalH() / 2 + logicalH() / 2 : _spaceship->y();
 	if ( !_zoominShip || _zoominShip->src().name() != _spaceship->flt_image().name() )
 	{
 		// ship changed, need to re-create animation from new ship image
 		delete _zoominShip;
 
-		_zoominShip = new ImageAnimation( _spaceship->flt_image(), 1.0,
-	                                     _effects > 1 && FPS >= 100 );
+		_zoominShip = new ImageAnimation( _spaceship->flt_image(), 1.0, zoomHQ() );
 		_zoominShip->setSizeMoveFromTo(
 		                 ImageAnimation::Rect( x_origin, y_origin,
 		                                       _spaceship->w(), _spaceship->h() ),
-		                 ImageAnimation::Rect( SCALE_X * 60, SCALE_Y * 40, w() - SCALE_X * 120, h() - SCALE_Y * 150 ) );
+		                 zoomRect() );
 		_zoominShip->start();
 	}
 	else if ( updateOrigin_ )
@@ -8190,10 +9965,9 @@ bool FLTrator::zoomoutShip()
 	{
 		// ship changed, need to re-create animation from new ship image
 		delete _zoomoutShip;
-		_zoomoutShip = new ImageAnimation( _spaceship->flt_image(), 1.0,
-		                                   _effects > 1 && FPS >= 100 );
+		_zoomoutShip = new ImageAnimation( _spaceship->flt_image(), 1.0, zoomHQ() );
 		_zoomoutShip->setSizeMoveFromTo(
-		                 ImageAnimation::Rect( SCALE_X * 60, SCALE_Y * 40, w() - SCALE_X * 120, h() - SCALE_Y * 150 ),
+		                 zoomRect(),
 		                 ImageAnimation::Rect( _spaceship->x(), _spaceship->y(),
 		                                       _spaceship->w(), _spaceship->h() ) );
 	}
@@ -8210,7 +9984,7 @@ bool FLTrator::zoomoutShip()
 void FLTrator::onTitleScreen()
 //-------------------------------------------------------------------------------
 {
-	if ( _trainMode )
+	if ( _trainMode || _autopilot )
 		return;
 	bool enterTitle = last_state() != TITLE && last_state() != NO_STATE;
 	_state = TITLE;
@@ -8246,6 +10020,7 @@ void FLTrator::onUpdateDemo()
 	bool bomb( false );
 	bool missile( false );
 	uint32_t seed, seed2;
+	checkpoint();
 	if ( !_demoData.get( _xoff, cx, cy, bomb, missile, seed, seed2 ) )
 		_done = true;
 	else
@@ -8281,9 +10056,6 @@ void FLTrator::onUpdateDemo()
 			dropBomb();
 		if ( missile )
 			fireMissile();
-
-		// reset missile/bomb for this xoff (maybe read again with next update)
-		_demoData.set( _xoff, cx, cy, false, false, seed, seed2 );
 	}
 
 	_draw_xoff = _xoff;
@@ -8302,9 +10074,9 @@ void FLTrator::onUpdateDemo()
 	int oxoff = _xoff;
 	_xoff = _dxoff;
 	_xdelta = _xoff - oxoff;
-	if ( _xoff + w() > (int)T.size() )
+	if ( _xoff + logicalW() > (int)T.size() )
 	{
-		_xoff = T.size() - w();
+		_xoff = T.size() - logicalW();
 		_dxoff = _xoff;
 		_done = true;
 	}
@@ -8347,6 +10119,27 @@ void FLTrator::onUpdate()
 		return;
 	}
 
+	// report heap allocations of last frame (with ALLOC_TRACK)
+	static bool allocTracking = false;
+	if ( _state == LEVEL && !paused() )
+		AllocTrack::check( "LEVEL", _xoff, allocTracking );
+	else
+		AllocTrack::disarm();
+	allocTracking = _state == LEVEL && !paused();
+
+	if ( recordDemo() )
+	{
+		// pass completed items to journal
+		DemoFile::Item item;
+		while ( _demoData.next( _xoff, item ) )
+			demoJournal().add( item );
+	}
+
+	if ( _endless )
+		stream_terrain();
+
+	checkpoint();
+
 	uint32_t seed, seed2;
 	seed = Random::Seed( seed2 );
 	_demoData.setSeed( _xoff, seed, seed2 );
@@ -8375,7 +10168,10 @@ void FLTrator::onUpdate()
 	}
 	startBgSound( true );
 
-	if ( _left && _xoff + _spaceship->cx() < _final_xoff - w() / 2 ) // no retreat at end!
+	if ( _autopilot && !_done && !_collision )
+		autopilot();	// sets the direction keys
+
+	if ( _left && _xoff + _spaceship->cx() < _final_xoff - logicalW() / 2 ) // no retreat at end!
 		_spaceship->left();
 	if ( _right )
 	{
@@ -8479,6 +10275,12 @@ int FLTrator::handle( int e_ )
 
 		int x = Fl::event_x();
 		int y = Fl::event_y();
+		if ( UPSCALE && _present_w && _present_h )
+		{
+			// map window to logical screen coordinates
+			x = ( x - _present_x ) * (int)SCREEN_W / _present_w;
+			y = ( y - _present_y ) * (int)SCREEN_H / _present_h;
+		}
 		switch ( e_ )
 		{
 			case TIMER_CALLBACK:
@@ -8696,6 +10498,8 @@ int FLTrator::handle( int e_ )
 			keyClick();
 			_input.erase( _input.size() - 1 );
 		}
+		if ( _state == DEMO && e_ == FL_KEYUP && c == FL_BackSpace && !_done )
+			rewind( logicalW() / 4 );
 		if ( _state == TITLE && e_ == FL_KEYUP )
 		{
 			if ( KEY_LEFT == c )
@@ -8800,6 +10604,11 @@ int FLTrator::handle( int e_ )
 				togglePaused();
 			}
 		}
+		else if ( FL_BackSpace == c && _trainMode )
+		{
+			if ( _state == LEVEL && !_done && !_collision && !G_paused )
+				rewind( logicalW() / 4 );
+		}
 		return 1;
 	}
 	return Inherited::handle( e_ );
@@ -8818,27 +10627,32 @@ int FLTrator::run()
 		LOG( "Using synced redraw with " << 1. / REDRAWS << " fps" );
 		Fl::add_timeout( REDRAWS, cb_redraw, this );
 	}
+	int ret = 0;
 	if ( _USE_FLTK_RUN )
 	{
 		LOG( "Using Fl::run()" );
 		Fl::add_timeout( FRAMES, cb_update, this );
-		return Fl::run();
+		ret = Fl::run();
 	}
-
-	LOG( "Using own main loop" );
-	while ( Fl::first_window() )
+	else
 	{
-		_waiter.wait( FPS );
-		// Workaround: due to initial system image caching, there may be
-		// delays at the begin of a terrain, that lead to speed correction,
-		// making it unplayable (ship collides with first obstacle).
-		// As a "fix" do not make speed correction as long as the ship
-		// is zoom out animated at level begin.
-		if ( !_zoomoutShip || _zoomoutShip->done() )
-			_correct_speed && correctDX();
-		_state == DEMO ? onUpdateDemo() : onUpdate();
+		LOG( "Using own main loop" );
+		while ( Fl::first_window() )
+		{
+			_waiter.wait( FPS );
+			// Workaround: due to initial system image caching, there may be
+			// delays at the begin of a terrain, that lead to speed correction,
+			// making it unplayable (ship collides with first obstacle).
+			// As a "fix" do not make speed correction as long as the ship
+			// is zoom out animated at level begin.
+			if ( !_zoomoutShip || _zoomoutShip->done() )
+				_correct_speed && correctDX();
+			_state == DEMO ? onUpdateDemo() : onUpdate();
+		}
 	}
-	return 0;
+	if ( _autopilot )
+		_pilot.report( cout, Startup::now() );
+	return ret;
 }
 
 static void message_position( int x_, int y_, int center_ )
@@ -8987,6 +10801,7 @@ static void cleanup()
 	}
 }
 
+#ifndef FLTRATOR_BENCH
 static void signalHandler( int sig_ )
 //-------------------------------------------------------------------------------
 {
@@ -9004,14 +10819,30 @@ static void installSignalHandler()
 	for ( size_t i = 0; i < nbrOfItems( signals ); i++ )
 		signal( signals[i], signalHandler );
 }
+#endif
 
 #ifdef WIN32
 #include "win32_console.H"
 #endif
 //-------------------------------------------------------------------------------
+static void startupTasks()
+//-------------------------------------------------------------------------------
+{
+	// Start loading of everything needed for the title screen in parallel.
+	// NOTE: lazy initialised statics used by the tasks must be set up here!
+	assets();
+	Startup::run( "ini", loadIniTask );
+	Startup::run( "cfg", readCfgTask );
+	for ( size_t i = 0; i < nbrOfItems( SPRITES ); i++ )
+		preloadImage( imgPath.get( SPRITES[i] ) );
+	preloadImage( imgPath.get( "spaceship0.gif" ) );
+}
+
+#ifndef FLTRATOR_BENCH	// (fltrator-bench.cxx has its own)
 int main( int argc_, const char *argv_[] )
 //-------------------------------------------------------------------------------
 {
+	Startup::mark( "main" );
 	atexit( cleanup );
 #ifdef WIN32
 	Console console;	// output goes to command window (if started from there)
@@ -9026,7 +10857,11 @@ int main( int argc_, const char *argv_[] )
 	Fl::scheme( "gtk+" );
 	int seed = time( 0 );
 	Random::pSrand( seed );
+	setupImageCache();
+	startupTasks();
 
 	FLTrator fltrator( argc_, argv_ );
+	Startup::mark( "window created" );
 	return fltrator.run();
 }
+#endif
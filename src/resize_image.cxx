@@ -1,9 +1,25 @@
 #include <FL/Fl_Image.H>
 
-#if !(FLTK_HAS_IMAGE_SCALING)
+// builtin resampler (used with KANTOR_RESAMPLE, verified by fltrator-bench)
+#if !(FLTK_HAS_IMAGE_SCALING) && (defined(KANTOR_RESAMPLE) || defined(FLTRATOR_BENCH))
 
 #include <string.h>
 #include <stdint.h> // uint64_t
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h> // sysconf()
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 // Written (c) by Roman Kantor
 // The code is Free software distributed under LGPL license with FLTK exceptions, see http://www.fltk.org/COPYING.php
@@ -254,6 +270,337 @@ void resample_scale(unsigned w1, unsigned w2, const U32 * source, unsigned char
 }
 
 
+
+// PACKED RGBA ROUTINES
+
+// For packed 4-channel data (RGBA) all channels of a pixel are resampled together in one pass over the image
+// instead of one pass per channel: the weights of the one-dimensional routines are the same for all channels.
+// The same RESAMPLE_DOWN/RESAMPLE_UP macros are used with "pixel" types holding the 4 channels in SIMD registers
+// (SSE2, 64 bit channels with AVX2), so the results are bit-identical to the per-channel routines.
+// Large images are processed in bands of rows/columns by several threads.
+
+struct P8 { // packed source/target pixel
+  unsigned char c[4];
+};
+
+#if defined(__SSE2__) || defined(_M_X64)
+
+inline __m128i mul_u32(__m128i v, unsigned k) { // 4 x 32 bit * k (low 32 bit of result)
+  __m128i K = _mm_set1_epi32((int)k);
+#ifdef __SSE4_1__
+  return _mm_mullo_epi32(v, K);
+#else
+  __m128i even = _mm_mul_epu32(v, K);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(v, 32), K);
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+struct P32 { // 4 channels, 32 bit
+  __m128i v;
+  P32() {}
+  P32(int) : v(_mm_setzero_si128()) {} // (only for 0)
+  P32(const P8 & p) {
+    int i;
+    memcpy(&i, p.c, 4);
+    __m128i zero = _mm_setzero_si128();
+    v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(i), zero), zero);
+  }
+  P32 & operator+=(const P32 & p) { v = _mm_add_epi32(v, p.v); return *this; }
+  P32 & operator*=(unsigned k) { v = mul_u32(v, k); return *this; }
+  void premultiply() { // colors * alpha (products fit into 16 bit)
+    __m128i a = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm_or_si128(_mm_and_si128(a, _mm_set_epi32(0, -1, -1, -1)), _mm_set_epi32(1, 0, 0, 0));
+    v = _mm_mullo_epi16(v, a);
+  }
+};
+inline P32 operator+(const P32 & a, const P32 & b) { P32 r(a); return r += b; }
+inline P32 operator*(const P32 & a, unsigned k) { P32 r(a); return r *= k; }
+inline P32 operator*(unsigned k, const P32 & a) { P32 r(a); return r *= k; }
+
+#ifdef __AVX2__
+
+struct P64 { // 4 channels, 64 bit
+  __m256i v;
+  P64() {}
+  P64(int) : v(_mm256_setzero_si256()) {} // (only for 0)
+  P64(const P32 & p) : v(_mm256_cvtepu32_epi64(p.v)) {}
+  P64 & operator+=(const P64 & p) { v = _mm256_add_epi64(v, p.v); return *this; }
+  P64 & operator*=(unsigned k) {
+    __m256i K = _mm256_set1_epi64x(k);
+    __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(v, 32), K);
+    v = _mm256_add_epi64(_mm256_mul_epu32(v, K), _mm256_slli_epi64(hi, 32));
+    return *this;
+  }
+  void get(U64 * c) const { _mm256_storeu_si256((__m256i *)c, v); }
+};
+
+#else // __AVX2__
+
+inline __m128i mul_u64(__m128i v, __m128i K) { // 2 x 64 bit * 32 bit k (low 64 bit of result)
+  __m128i hi = _mm_mul_epu32(_mm_srli_epi64(v, 32), K);
+  return _mm_add_epi64(_mm_mul_epu32(v, K), _mm_slli_epi64(hi, 32));
+}
+
+struct P64 { // 4 channels, 64 bit
+  __m128i lo, hi;
+  P64() {}
+  P64(int) : lo(_mm_setzero_si128()), hi(_mm_setzero_si128()) {} // (only for 0)
+  P64(const P32 & p) {
+    __m128i zero = _mm_setzero_si128();
+    lo = _mm_unpacklo_epi32(p.v, zero);
+    hi = _mm_unpackhi_epi32(p.v, zero);
+  }
+  P64 & operator+=(const P64 & p) { lo = _mm_add_epi64(lo, p.lo); hi = _mm_add_epi64(hi, p.hi); return *this; }
+  P64 & operator*=(unsigned k) {
+    __m128i K = _mm_set_epi32(0, (int)k, 0, (int)k);
+    lo = mul_u64(lo, K);
+    hi = mul_u64(hi, K);
+    return *this;
+  }
+  void get(U64 * c) const { _mm_storeu_si128((__m128i *)c, lo); _mm_storeu_si128((__m128i *)(c + 2), hi); }
+};
+
+#endif // __AVX2__
+
+#else // SSE2
+
+struct P32 { // 4 channels, 32 bit
+  U32 c[4];
+  P32() {}
+  P32(int) { c[0] = c[1] = c[2] = c[3] = 0; } // (only for 0)
+  P32(const P8 & p) { for(int i = 0; i < 4; i++) c[i] = p.c[i]; }
+  P32 & operator+=(const P32 & p) { for(int i = 0; i < 4; i++) c[i] += p.c[i]; return *this; }
+  P32 & operator*=(unsigned k) { for(int i = 0; i < 4; i++) c[i] *= k; return *this; }
+  void premultiply() { for(int i = 0; i < 3; i++) c[i] *= c[3]; }
+};
+inline P32 operator+(const P32 & a, const P32 & b) { P32 r(a); return r += b; }
+inline P32 operator*(const P32 & a, unsigned k) { P32 r(a); return r *= k; }
+inline P32 operator*(unsigned k, const P32 & a) { P32 r(a); return r *= k; }
+
+struct P64 { // 4 channels, 64 bit
+  U64 c[4];
+  P64() {}
+  P64(int) { c[0] = c[1] = c[2] = c[3] = 0; } // (only for 0)
+  P64(const P32 & p) { for(int i = 0; i < 4; i++) c[i] = p.c[i]; }
+  P64 & operator+=(const P64 & p) { for(int i = 0; i < 4; i++) c[i] += p.c[i]; return *this; }
+  P64 & operator*=(unsigned k) { for(int i = 0; i < 4; i++) c[i] *= k; return *this; }
+  void get(U64 * c_) const { for(int i = 0; i < 4; i++) c_[i] = c[i]; }
+};
+
+#endif // SSE2
+
+inline P64 operator+(const P64 & a, const P64 & b) { P64 r(a); return r += b; }
+inline P64 operator*(const P64 & a, unsigned k) { P64 r(a); return r *= k; }
+inline P64 operator*(unsigned k, const P64 & a) { P64 r(a); return r *= k; }
+
+// scale back one pixel (alpha first, as the colors are divided by the resulting alpha - see resample_scale())
+inline void store_scaled(P8 * tg, const P64 & output, U64 scale, U64 sc_add, bool alpha_premultiply)
+{
+  U64 c[4];
+  output.get(c);
+  tg->c[3] = (c[3] + sc_add) / scale;
+  if(alpha_premultiply) {
+    U64 alpha = scale * tg->c[3];
+    if(!alpha) alpha = 1;
+    for(int i = 0; i < 3; i++)
+      tg->c[i] = (c[i] + sc_add + alpha / 2) / (alpha + scale);
+  } else {
+    for(int i = 0; i < 3; i++)
+      tg->c[i] = (c[i] + sc_add) / scale;
+  }
+}
+
+// packed version of resample() for the sets [from, to)
+void resample_packed(unsigned w1, unsigned w2, const P8 * source, P32 * target,
+                     int source_stride, int target_stride,
+                     unsigned from, unsigned to, int source_set_stride, int target_set_stride,
+                     bool alpha_premultiply)
+{
+  for(unsigned j = from; j < to; j++) {
+    const P8 * sou = source + j * source_set_stride;
+    P32 * tar = target + j * target_set_stride;
+    if(w2 < w1) {
+      if(alpha_premultiply)
+        RESAMPLE_DOWN(P8, P32, P32, w1, w2, sou, tar,
+                      source_stride, target_stride,
+                      input.premultiply();, *tg = output;)
+      else
+        RESAMPLE_DOWN(P8, P32, P32, w1, w2, sou, tar,
+                      source_stride, target_stride,
+                      ;, *tg = output;)
+    } else {
+      if(alpha_premultiply)
+        RESAMPLE_UP(P8, P32, P32, w1, w2, sou, tar,
+                    source_stride, target_stride,
+                    input.premultiply();, *tg = output;)
+      else
+        RESAMPLE_UP(P8, P32, P32, w1, w2, sou, tar,
+                    source_stride, target_stride,
+                    ;, *tg = output;)
+    }
+  }
+}
+
+// packed version of resample_scale() for the sets [from, to)
+void resample_scale_packed(unsigned w1, unsigned w2, const P32 * source, P8 * target,
+                           int source_stride, int target_stride,
+                           unsigned from, unsigned to, int source_set_stride, int target_set_stride,
+                           U64 scale, bool alpha_premultiply)
+{
+  U64 sc_add = scale / 2;
+  for(unsigned j = from; j < to; j++) {
+    const P32 * sou = source + j * source_set_stride;
+    P8 * tar = target + j * target_set_stride;
+    if(w2 < w1)
+      RESAMPLE_DOWN(P32, P8, P64, w1, w2, sou, tar,
+                    source_stride, target_stride,
+                    ;, store_scaled(tg, output, scale, sc_add, alpha_premultiply);)
+    else
+      RESAMPLE_UP(P32, P8, P64, w1, w2, sou, tar,
+                  source_stride, target_stride,
+                  ;, store_scaled(tg, output, scale, sc_add, alpha_premultiply);)
+  }
+}
+
+// one pass (resample_packed() or resample_scale_packed()) over a band of sets
+struct PackedPass {
+  bool scale_pass;
+  unsigned w1, w2;
+  const void * source;
+  void * target;
+  int source_stride, target_stride;
+  unsigned from, to;
+  int source_set_stride, target_set_stride;
+  U64 scale;
+  bool alpha_premultiply;
+};
+
+void run_pass(const PackedPass & p)
+{
+  if(p.scale_pass)
+    resample_scale_packed(p.w1, p.w2, (const P32 *)p.source, (P8 *)p.target,
+                          p.source_stride, p.target_stride, p.from, p.to,
+                          p.source_set_stride, p.target_set_stride, p.scale, p.alpha_premultiply);
+  else
+    resample_packed(p.w1, p.w2, (const P8 *)p.source, (P32 *)p.target,
+                    p.source_stride, p.target_stride, p.from, p.to,
+                    p.source_set_stride, p.target_set_stride, p.alpha_premultiply);
+}
+
+#ifdef WIN32
+DWORD WINAPI pass_thread(LPVOID p) { run_pass(*(const PackedPass *)p); return 0; }
+#else
+void * pass_thread(void * p) { run_pass(*(const PackedPass *)p); return 0; }
+#endif
+
+const int MAX_RESAMPLE_THREADS = 4;
+const int MIN_RESAMPLE_PIXELS = 256 * 256; // per thread (below starting a thread costs more than it saves)
+
+int resample_threads(unsigned pixels)
+{
+  static int cpus = 0;
+  if(!cpus) {
+#ifdef WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    cpus = si.dwNumberOfProcessors;
+#else
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if(cpus < 1) cpus = 1;
+  }
+  int n = pixels / MIN_RESAMPLE_PIXELS;
+  if(n > cpus) n = cpus;
+  if(n > MAX_RESAMPLE_THREADS) n = MAX_RESAMPLE_THREADS;
+  return n < 1 ? 1 : n;
+}
+
+// run pass 'p' over 'sets' sets split into bands for 'threads' threads (the last band is done by the caller)
+void run_parallel(const PackedPass & p, unsigned sets, int threads)
+{
+  PackedPass band[MAX_RESAMPLE_THREADS];
+#ifdef WIN32
+  HANDLE tid[MAX_RESAMPLE_THREADS];
+#else
+  pthread_t tid[MAX_RESAMPLE_THREADS];
+#endif
+  bool started[MAX_RESAMPLE_THREADS];
+  for(int t = 0; t < threads - 1; t++) {
+    band[t] = p;
+    band[t].from = sets * t / threads;
+    band[t].to = sets * (t + 1) / threads;
+#ifdef WIN32
+    tid[t] = CreateThread(NULL, 0, pass_thread, &band[t], 0, NULL);
+    started[t] = tid[t] != NULL;
+#else
+    started[t] = pthread_create(&tid[t], 0, pass_thread, &band[t]) == 0;
+#endif
+    if(!started[t]) run_pass(band[t]);
+  }
+  PackedPass last = p;
+  last.from = sets * (threads - 1) / threads;
+  last.to = sets;
+  run_pass(last);
+  for(int t = 0; t < threads - 1; t++) {
+    if(!started[t]) continue;
+#ifdef WIN32
+    WaitForSingleObject(tid[t], INFINITE);
+    CloseHandle(tid[t]);
+#else
+    pthread_join(tid[t], 0);
+#endif
+  }
+}
+
+// resample packed RGBA data (strides in pixels) - same parameters and results as resample()
+void resample_rgba(int w2, int h2, const unsigned char * source, int w1, int h1,
+                   int row_stride, unsigned char * target, int target_row_stride,
+                   bool alpha_premultiply)
+{
+  const P8 * src = (const P8 *)source;
+  P8 * tgt = (P8 *)target;
+  int s = w2 * h1;
+  bool rows_first = 1;
+  {
+    int s2 = w1 * h2;
+    if(s2 < s) {
+      s = s2;
+      rows_first = 0;
+    }
+  }
+  int threads = resample_threads(w1 * h1 > w2 * h2 ? w1 * h1 : w2 * h2);
+  P32 * buffer = new P32[s]; // intermediate buffer
+  PackedPass p1, p2;
+  p1.scale_pass = false;
+  p2.scale_pass = true;
+  p1.source = src;
+  p1.target = buffer;
+  p2.source = buffer;
+  p2.target = tgt;
+  p1.alpha_premultiply = p2.alpha_premultiply = alpha_premultiply;
+  p1.scale = 0;
+  p2.scale = ((U64)(get_resample_scale(w1, w2))) * ((U64)(get_resample_scale(h1, h2)));
+  if(rows_first) {
+    p1.w1 = w1; p1.w2 = w2; p1.source_stride = 1; p1.target_stride = 1;
+    p1.source_set_stride = row_stride; p1.target_set_stride = w2;
+    run_parallel(p1, h1, threads);
+    p2.w1 = h1; p2.w2 = h2; p2.source_stride = w2; p2.target_stride = target_row_stride;
+    p2.source_set_stride = 1; p2.target_set_stride = 1;
+    run_parallel(p2, w2, threads);
+  } else {
+    p1.w1 = h1; p1.w2 = h2; p1.source_stride = row_stride; p1.target_stride = w1;
+    p1.source_set_stride = 1; p1.target_set_stride = 1;
+    run_parallel(p1, w1, threads);
+    p2.w1 = w1; p2.w2 = w2; p2.source_stride = 1; p2.target_stride = 1;
+    p2.source_set_stride = w1; p2.target_set_stride = target_row_stride;
+    run_parallel(p2, h2, threads);
+  }
+  delete[] buffer;
+}
+
+
 // Finaly this is synthesis of the above functions to use optimal resizing approach.
 // Parameters:
 // w2, h2 - new (resampled) image size
@@ -265,6 +612,7 @@ void resample_scale(unsigned w1, unsigned w2, const U32 * source, unsigned char
 // target - pointer to array where resampled image data are stored. If 0, a new array is allocated with sufficient size.
 // target_pixel_stride - pointer shift from pixel to pixel for the resampled image. If 0, "packed" data are assumed and target_pixel_stride equals to no_channels
 // target_row_stride - pointer shift between rows for the resampled image. If 0, target_row_stride = w2 * target_pixel_stride.
+// packed - use the packed RGBA routines if possible (false: always resample channel by channel, e.g. for comparing the results)
 // The function returns the "target" parameter or pointer to newly allocated data (if target==0) - in such a case free this memory using operator delete[].
 
 
@@ -272,7 +620,7 @@ unsigned char * resample(int w2, int h2, const unsigned char * const source,
                          int w1, int h1, int no_channels,
                          int pixel_stride = 0, int row_stride = 0,
                          unsigned char * target = 0, int target_pixel_stride = 0, int target_row_stride = 0,
-                         bool alpha_premultiply = false)
+                         bool alpha_premultiply = false, bool packed = true)
 {
   if(!pixel_stride) pixel_stride = no_channels;
   if(!row_stride) row_stride = pixel_stride * w1;
@@ -322,6 +670,12 @@ unsigned char * resample(int w2, int h2, const unsigned char * const source,
   }
 
 
+  if(packed && no_channels == 4 && pixel_stride == 4 && target_pixel_stride == 4 &&
+     !(row_stride % 4) && !(target_row_stride % 4)) {
+    resample_rgba(w2, h2, src, w1, h1, row_stride / 4, target, target_row_stride / 4, alpha_premultiply);
+    return target;
+  }
+
   // General rescaling with intermediate U32 data array.
   // First we try to find optimal approach to minimize intermediate data size:
   int s = w2 * h1;
@@ -371,7 +725,7 @@ unsigned char * resample(int w2, int h2, const unsigned char * const source,
 
 }  // end of anonymous namespace
 
-#endif //!(FLTK_HAS_IMAGE_SCALING)
+#endif //!(FLTK_HAS_IMAGE_SCALING) && (KANTOR_RESAMPLE || FLTRATOR_BENCH)
 
 // This is a simple function to replace Fl_RGB_Image::copy().
 // Note a clumsy hack to detect Fl_RGB_IMAGE (or subclass) using count() and d() methods.
@@ -394,8 +748,11 @@ Fl_Image * fl_copy_image(Fl_Image * im, int w2, int h2)
 #pragma message( "FLTK_HAS_IMAGE_SCALING" )
   Fl_Image *ni = im->copy();
   ni->scale(w2, h2, 0, 1); // let the hardware do the scaling!
+#elif !defined(KANTOR_RESAMPLE)
+  // FLTK's own scaling, unless the builtin resampler is enabled (make RESAMPLE=1):
+  // its results differ from Fl_RGB_Image::copy() (see fltrator-bench)
+  Fl_Image *ni = im->copy(w2, h2);
 #else
-  return im->copy(w2, h2);
   int ld = im->ld();
   int w1 = im->w();
   int pixel_stride = im->d();